@@ -2,12 +2,16 @@
 #define UDU_ARGS_H
 
 #include "const.h"
+#include "udu.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #define INIT_CAPACITY 16
+#define AGE_BUCKETS_MAX UDU_AGE_BUCKETS_MAX // thresholds + 1
 #define GROWTH_FACTOR 2
 
 static const char *USAGE =
@@ -22,7 +26,41 @@ static const char *USAGE =
   "  -q, --quiet            display output only at program exit (default)\n"
   "  -v, --verbose          display each processed file\n"
   "  -t, --tree             mimic the output of 'tree' command\n"
+  "  -d, --max-depth=N      list the total of every directory at most N\n"
+  "                          levels below a scanned path (like du -d N)\n"
   "      --version          display version information and exit\n"
+  "      --sparse           report apparent size, allocation and bytes saved\n"
+  "                          by sparse files side by side\n"
+  "      --min-sparse-ratio=R\n"
+  "                         list files whose apparent size is at least R\n"
+  "                          times their allocation (implies --sparse)\n"
+  "      --age-buckets[=D1,D2,...]\n"
+  "                         split usage by file age in days\n"
+  "                          (default 30,90,180,365)\n"
+  "      --time=WORD        age by mtime (default), atime or ctime\n"
+  "      --by-user          report usage per file owner\n"
+  "      --by-group         report usage per file group\n"
+  "      --top-files=K      report the K largest files\n"
+  "      --top-dirs=K       report the K largest directories\n"
+  "      --save-snapshot=FILE  write per-directory totals to FILE\n"
+  "      --diff=FILE        compare against a saved snapshot and list the\n"
+  "                          directories that changed, largest growth first\n"
+  "      --diff-threshold=SIZE\n"
+  "                         only list changes of at least SIZE (e.g. 100M)\n"
+  "      --root-cache=FILE  remember per-root entry counts in FILE and scan\n"
+  "                          the largest roots first on the next run\n"
+  "      --min-size=SIZE    only count files of at least SIZE (e.g. 1G)\n"
+  "      --max-size=SIZE    only count files of at most SIZE\n"
+  "      --type=LIST        only count files of these types: f (regular),\n"
+  "                          b, c (devices), p (fifo), s (socket)\n"
+  "      --newer=FILE       only count files modified after FILE (the\n"
+  "                          time chosen by --time is compared)\n"
+  "      --inode-order      stat the entries of each directory in inode\n"
+  "                          order (helps cold caches on disks)\n"
+  "      --daemon           scan once, keep totals current with inotify and\n"
+  "                          answer --query requests (Linux)\n"
+  "      --query=PATH       print the totals of PATH from a running daemon\n"
+  "      --socket=PATH      daemon socket (default $XDG_RUNTIME_DIR/udu.sock)\n"
   "  -X, --exclude=PATTERN  skip files or directories that match a glob "
   "pattern\n"
   "                          *        any characters\n"
@@ -46,12 +84,37 @@ typedef struct
     int path_count;
     char **excludes;
     int exclude_count;
+    char *root_cache;
+    char *save_snapshot;
+    char *diff;
+    uint64_t diff_threshold;
+    char *socket_path; // NULL: default location
+    char *query;
+    double min_sparse_ratio;
+    int top_files;
+    int top_dirs;
+    int max_depth; // -1: no per-directory listing
+    uint64_t min_size;
+    uint64_t max_size; // UINT64_MAX: no limit
+    char *types; // --type letters, NULL for any
+    char *newer_file;
+    bool newer;
+    int64_t newer_than; // newer_file's time, as selected by age_time
+    int age_days[AGE_BUCKETS_MAX - 1]; // increasing bucket limits
+    int age_count; // number of limits; 0 disables age accounting
+    char age_time; // 'm', 'a' or 'c'
     bool apparent_size;
     bool verbose;
     bool quiet;
     bool help;
     bool version;
     bool tree;
+    bool sparse;
+    bool by_user;
+    bool by_group;
+    bool dir_list; // collect udu_result_t.dir_list
+    bool daemon;
+    bool inode_order;
 } args_t;
 
 UDU_SI bool ensure_capacity(char ***array, int *capacity, int count)
@@ -67,9 +130,101 @@ UDU_SI bool ensure_capacity(char ***array, int *capacity, int count)
     return true;
 }
 
+UDU_SI bool parse_count(const char *s, int *out)
+{
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || v < 0 || v > 1000000)
+    {
+        fprintf(stderr, "Error: invalid count '%s'\n", s);
+        return false;
+    }
+    *out = (int)v;
+    return true;
+}
+
+// byte count with an optional K, M, G, T or P (powers of 1024) suffix
+UDU_SI bool parse_size(const char *s, uint64_t *out)
+{
+    static const char units[] = "KMGTP";
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (end == s || *s == '-') goto bad;
+
+    if (*end)
+    {
+        const char *u = strchr(units, *end);
+        if (!u) goto bad;
+        if (end[1] == 'B' || end[1] == 'b') end++;
+        if (end[1]) goto bad;
+        for (const char *p = units; p <= u; p++)
+        {
+            if (v > UINT64_MAX / 1024) goto bad;
+            v *= 1024;
+        }
+    }
+
+    *out = v;
+    return true;
+
+bad:
+    fprintf(stderr, "Error: invalid size '%s'\n", s);
+    return false;
+}
+
+UDU_SI bool parse_age_buckets(const char *spec, args_t *args)
+{
+    const char *s = spec;
+    args->age_count = 0;
+    do
+    {
+        char *end;
+        long days = strtol(s, &end, 10);
+        if (end == s || (*end && (*end != ',' || !end[1])) || days <= 0 ||
+            days > 1000000 || args->age_count == AGE_BUCKETS_MAX - 1 ||
+            (args->age_count > 0 &&
+             days <= args->age_days[args->age_count - 1]))
+        {
+            fprintf(stderr,
+                    "Error: invalid age buckets '%s' (expected up to %d "
+                    "increasing day counts)\n",
+                    spec,
+                    AGE_BUCKETS_MAX - 1);
+            return false;
+        }
+        args->age_days[args->age_count++] = (int)days;
+        s = *end ? end + 1 : end;
+    } while (*s);
+    return true;
+}
+
+// --type=f,p or --type=fp; directories are always descended and
+// symlinks never followed, so only the other types can be chosen
+UDU_SI bool parse_types(const char *spec, args_t *args)
+{
+    bool any = false;
+    for (const char *s = spec; *s || !any; s++)
+    {
+        if (*s == ',') continue;
+        any = true;
+        if (!*s || !strchr("fbcps", *s))
+        {
+            fprintf(stderr,
+                    "Error: invalid type list '%s' (expected letters from "
+                    "f, b, c, p, s)\n",
+                    spec);
+            return false;
+        }
+    }
+    args->types = (char *)spec;
+    return true;
+}
+
 UDU_SI void args_init(args_t *args)
 {
     memset(args, 0, sizeof(args_t));
+    args->max_depth = -1;
+    args->max_size = UINT64_MAX;
 }
 
 UDU_SI void args_free(args_t *args)
@@ -133,6 +288,13 @@ UDU_SI bool handle_short_option(char opt,
             }
             args->excludes[args->exclude_count++] = argv[++(*i)];
             return true;
+        case 'd':
+            if (*i + 1 >= argc)
+            {
+                fprintf(stderr, "Error: -d requires a depth argument\n");
+                return false;
+            }
+            return parse_count(argv[++(*i)], &args->max_depth);
         default:
             fprintf(stderr, "Error: unknown option '-%c'\n", opt);
             return false;
@@ -154,6 +316,7 @@ UDU_SI bool args_parse(args_t *args, int argc, char **argv)
     }
 
     args->quiet = true;
+    args->age_time = 'm';
 
     for (int i = 1; i < argc; i++)
     {
@@ -202,6 +365,118 @@ UDU_SI bool args_parse(args_t *args, int argc, char **argv)
                 args->quiet = true;
                 // args->verbose = false; (if true goes in tree-verbose mode)
             }
+            else if (strcmp(arg, "--sparse") == 0)
+            {
+                args->sparse = true;
+            }
+            else if (strncmp(arg, "--min-sparse-ratio=", 19) == 0)
+            {
+                char *end;
+                args->min_sparse_ratio = strtod(arg + 19, &end);
+                if (end == arg + 19 || *end != '\0' ||
+                    !(args->min_sparse_ratio >= 1.0))
+                {
+                    fprintf(stderr,
+                            "Error: invalid sparse ratio '%s' (must be >= 1)\n",
+                            arg + 19);
+                    return false;
+                }
+                args->sparse = true;
+            }
+            else if (strcmp(arg, "--age-buckets") == 0)
+            {
+                parse_age_buckets("30,90,180,365", args);
+            }
+            else if (strncmp(arg, "--age-buckets=", 14) == 0)
+            {
+                if (!parse_age_buckets(arg + 14, args)) return false;
+            }
+            else if (strncmp(arg, "--time=", 7) == 0)
+            {
+                const char *w = arg + 7;
+                if (!strcmp(w, "mtime") || !strcmp(w, "modification"))
+                    args->age_time = 'm';
+                else if (!strcmp(w, "atime") || !strcmp(w, "access") ||
+                         !strcmp(w, "use"))
+                    args->age_time = 'a';
+                else if (!strcmp(w, "ctime") || !strcmp(w, "status"))
+                    args->age_time = 'c';
+                else
+                {
+                    fprintf(stderr, "Error: invalid time '%s'\n", w);
+                    return false;
+                }
+            }
+            else if (strcmp(arg, "--by-user") == 0)
+            {
+                args->by_user = true;
+            }
+            else if (strcmp(arg, "--by-group") == 0)
+            {
+                args->by_group = true;
+            }
+            else if (strncmp(arg, "--top-files=", 12) == 0)
+            {
+                if (!parse_count(arg + 12, &args->top_files)) return false;
+            }
+            else if (strncmp(arg, "--top-dirs=", 11) == 0)
+            {
+                if (!parse_count(arg + 11, &args->top_dirs)) return false;
+            }
+            else if (strncmp(arg, "--save-snapshot=", 16) == 0)
+            {
+                args->save_snapshot = (char *)(arg + 16);
+                args->dir_list = true;
+            }
+            else if (strncmp(arg, "--diff=", 7) == 0)
+            {
+                args->diff = (char *)(arg + 7);
+                args->dir_list = true;
+            }
+            else if (strncmp(arg, "--diff-threshold=", 17) == 0)
+            {
+                if (!parse_size(arg + 17, &args->diff_threshold)) return false;
+            }
+            else if (strncmp(arg, "--root-cache=", 13) == 0)
+            {
+                args->root_cache = (char *)(arg + 13);
+            }
+            else if (strncmp(arg, "--max-depth=", 12) == 0)
+            {
+                if (!parse_count(arg + 12, &args->max_depth)) return false;
+            }
+            else if (strncmp(arg, "--min-size=", 11) == 0)
+            {
+                if (!parse_size(arg + 11, &args->min_size)) return false;
+            }
+            else if (strncmp(arg, "--max-size=", 11) == 0)
+            {
+                if (!parse_size(arg + 11, &args->max_size)) return false;
+            }
+            else if (strncmp(arg, "--type=", 7) == 0)
+            {
+                if (!parse_types(arg + 7, args)) return false;
+            }
+            else if (strncmp(arg, "--newer=", 8) == 0)
+            {
+                args->newer_file = (char *)(arg + 8);
+            }
+            else if (strcmp(arg, "--inode-order") == 0)
+            {
+                args->inode_order = true;
+            }
+            else if (strcmp(arg, "--daemon") == 0)
+            {
+                args->daemon = true;
+            }
+            else if (strncmp(arg, "--query=", 8) == 0)
+            {
+                args->query = (char *)(arg + 8);
+            }
+            else if (strncmp(arg, "--socket=", 9) == 0)
+            {
+                args->socket_path = (char *)(arg + 9);
+            }
             else if (strncmp(arg, "--exclude=", 10) == 0)
             {
                 if (!ensure_capacity(
@@ -222,13 +497,20 @@ UDU_SI bool args_parse(args_t *args, int argc, char **argv)
             // handle GNU style options e.g. -avq
             for (int j = 1; arg[j] != '\0'; j++)
             {
+                // -dN: the depth may be attached
+                if (arg[j] == 'd' && arg[j + 1])
+                {
+                    if (!parse_count(arg + j + 1, &args->max_depth))
+                        return false;
+                    break;
+                }
                 if (!handle_short_option(
                       arg[j], args, &i, argc, argv, &exclude_capacity))
                 {
                     return false;
                 }
-                // If handled -X ; it consumed the next arg so break
-                if (arg[j] == 'X')
+                // If handled -X or -d ; it consumed the next arg so break
+                if (arg[j] == 'X' || arg[j] == 'd')
                 {
                     break;
                 }
@@ -241,6 +523,45 @@ UDU_SI bool args_parse(args_t *args, int argc, char **argv)
         return true;
     }
 
+    if (args->tree && (args->save_snapshot || args->diff))
+    {
+        fprintf(stderr, "Error: snapshots cannot be combined with --tree\n");
+        return false;
+    }
+
+    // after the loop: --time may follow --newer
+    if (args->newer_file)
+    {
+        struct stat sb;
+        if (stat(args->newer_file, &sb) != 0)
+        {
+            fprintf(stderr, "Error: cannot stat '%s'\n", args->newer_file);
+            return false;
+        }
+        args->newer = true;
+        args->newer_than = (int64_t)(args->age_time == 'a'   ? sb.st_atime
+                                     : args->age_time == 'c' ? sb.st_ctime
+                                                             : sb.st_mtime);
+    }
+
+    if (args->min_size > args->max_size)
+    {
+        fprintf(stderr, "Error: --min-size is larger than --max-size\n");
+        return false;
+    }
+
+    if (args->tree && args->max_depth >= 0)
+    {
+        fprintf(stderr, "Error: --max-depth cannot be combined with --tree\n");
+        return false;
+    }
+
+    if (args->daemon && args->query)
+    {
+        fprintf(stderr, "Error: --daemon and --query are exclusive\n");
+        return false;
+    }
+
     if (args->path_count == 0)
     {
         args->paths[0] = ".";
@@ -2,6 +2,10 @@
     #define VERSION "unknown"
 #endif
 
+// directories below this many levels are not descended into; each one
+// is reported as a UDU_ERR_DEPTH failure
+#define MAX_DEPTH 64
+
 // Handle Compilers
 #if defined(__GNUC__) || defined(__clang__)
     #define UDU_SI static inline __attribute__((always_inline))
@@ -18,3 +22,15 @@
 #else
     #define UDU_THD
 #endif
+
+// built with `make CLONES=1`: one copy of a hot function per CPU level,
+// picked by the loader at startup (ifunc: glibc and ELF only)
+#if defined(UDU_CLONES) && defined(__x86_64__)
+    #define UDU_HOT __attribute__((target_clones("avx2", "sse4.2", "default")))
+#elif defined(UDU_CLONES) && defined(__aarch64__) &&                          \
+    ((defined(__clang__) && __clang_major__ >= 16) ||                         \
+     (!defined(__clang__) && __GNUC__ >= 14))
+    #define UDU_HOT __attribute__((target_clones("sve2", "default")))
+#else
+    #define UDU_HOT
+#endif
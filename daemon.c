@@ -0,0 +1,1033 @@
+/*
+ * Resident mode: one parallel scan builds an in-memory tree of
+ * directories, each holding its files' sizes (keyed by a 64-bit name
+ * hash) and its subtree totals. inotify then reports changes per
+ * directory; every distinct (directory, name) pair in a batch of events
+ * is stat'ed once and the size delta is added to the directory and all
+ * of its ancestors. Work is proportional to the rate of change, and a
+ * query is a walk down the path components.
+ *
+ * Protocol: a client sends an absolute path terminated by '\n' and gets
+ * back "<bytes> <files> <directories>\n", or "ERR <reason>\n". An empty
+ * line asks for the sum of all scanned paths.
+ */
+
+#include "daemon.h"
+#include "const.h"
+#include "platform.h"
+#include "util.h"
+#include "walk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+
+    #include <errno.h>
+    #include <limits.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/inotify.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+
+    #ifdef _OPENMP
+        #include <omp.h>
+    #endif
+
+    #define WATCH_MASK                                                         \
+        (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM |  \
+         IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+    #define MAX_CLIENTS 64
+    #define EVENT_BUF (64 * 1024)
+    #define INIT_CAP 16
+    #define FENT_EMPTY 0 // name_hash() never returns it
+
+typedef struct
+{
+    uint64_t hash;
+    uint64_t size;
+} fent_t;
+
+// kids and files are open-addressing tables like walk.c's otab_t: a
+// power-of-two capacity, linear probing, and a load kept under 3/4, so an
+// event costs the same in a directory of ten entries or a million
+typedef struct dnode_s
+{
+    char *name; // last component; the full path for roots
+    uint64_t hash; // name_hash() of name, its key in the parent's kids
+    struct dnode_s *parent;
+    struct dnode_s **kids; // NULL marks a free slot
+    uint32_t nkids;
+    uint32_t kcap;
+    fent_t *files; // FENT_EMPTY marks a free slot
+    uint32_t nfiles;
+    uint32_t fcap;
+    int wd;
+    uint64_t size; // subtree totals; tdirs counts the node itself
+    uint64_t tfiles;
+    uint64_t tdirs;
+} dnode_t;
+
+typedef struct
+{
+    const args_t *cfg;
+    int ifd;
+    dnode_t **roots;
+    int nroots;
+    dnode_t **bywd; // inotify watch descriptor -> node
+    int wdcap;
+    bool warned;
+    udu_result_t errs; // failures not reported yet; only the error fields
+} dstate_t;
+
+typedef struct
+{
+    int wd; // resolved at refresh time: an earlier refresh may free the node
+    uint64_t hash;
+    char *name;
+} pending_t;
+
+typedef struct
+{
+    int fd;
+    size_t len;
+    char buf[PATH_MAX + 2];
+} client_t;
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+UDU_SI uint64_t name_hash(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 0x100000001b3ull;
+    return h ? h : 1;
+}
+
+// whether the entry in slot `j`, whose probe starts at `home`, may fill
+// the hole at `i`: deleting by shifting back keeps tables tombstone-free
+UDU_SI bool slot_movable(uint32_t i, uint32_t j, uint32_t home)
+{
+    return i <= j ? (home <= i || home > j) : (home <= i && home > j);
+}
+
+UDU_SI bool excluded(const dstate_t *ds, const char *name, const char *path)
+{
+    for (int i = 0; i < ds->cfg->exclude_count; i++)
+    {
+        const char *pat = ds->cfg->excludes[i];
+        if (glob_match(pat, name) || glob_match(pat, path)) return true;
+    }
+    return false;
+}
+
+// `code` is the errno of the failed call, as for walk()'s record_error()
+static void fail(dstate_t *ds, const char *path, int code)
+{
+    #ifdef _OPENMP
+        #pragma omp critical(daemon_errs)
+    #endif
+    walk_record_error(&ds->errs, path, code);
+}
+
+// print what could not be read since the last report, as udu does
+static void report_errors(dstate_t *ds)
+{
+    if (!ds->errs.nfailed) return;
+    walk_print_errors(&ds->errs);
+    walk_result_free(&ds->errs);
+}
+
+static dnode_t *dnode_new(const char *name, dnode_t *parent)
+{
+    dnode_t *node = calloc(1, sizeof(dnode_t));
+    if (!node) return NULL;
+    node->name = strdup(name);
+    if (!node->name)
+    {
+        free(node);
+        return NULL;
+    }
+    node->hash = name_hash(name, strlen(name));
+    node->parent = parent;
+    node->wd = -1;
+    node->tdirs = 1;
+    return node;
+}
+
+static dnode_t **kid_slot(dnode_t **v,
+                          uint32_t cap,
+                          uint64_t hash,
+                          const char *name,
+                          size_t len)
+{
+    uint32_t i = (uint32_t)hash & (cap - 1);
+    for (; v[i]; i = (i + 1) & (cap - 1))
+        if (v[i]->hash == hash && strncmp(v[i]->name, name, len) == 0 &&
+            v[i]->name[len] == '\0')
+            break;
+    return &v[i];
+}
+
+static bool kid_grow(dnode_t *node)
+{
+    uint32_t cap = node->kcap ? node->kcap * 2 : INIT_CAP;
+    dnode_t **v = calloc(cap, sizeof(dnode_t *));
+    if (!v) return false;
+
+    for (uint32_t i = 0; i < node->kcap; i++)
+    {
+        dnode_t *kid = node->kids[i];
+        if (!kid) continue;
+        uint32_t j = (uint32_t)kid->hash & (cap - 1);
+        while (v[j]) j = (j + 1) & (cap - 1);
+        v[j] = kid;
+    }
+
+    free(node->kids);
+    node->kids = v;
+    node->kcap = cap;
+    return true;
+}
+
+// the slot holding the subdirectory `name` (`len` bytes), or NULL
+static dnode_t **kid_find(const dnode_t *node, const char *name, size_t len)
+{
+    if (!node->kcap) return NULL;
+    dnode_t **slot =
+      kid_slot(node->kids, node->kcap, name_hash(name, len), name, len);
+    return *slot ? slot : NULL;
+}
+
+// `kid` must not be in the table yet
+static bool kid_add(dnode_t *node, dnode_t *kid)
+{
+    if ((node->nkids + 1) * 4 > node->kcap * 3 && !kid_grow(node))
+        return false;
+
+    size_t len = strlen(kid->name);
+    *kid_slot(node->kids, node->kcap, kid->hash, kid->name, len) = kid;
+    node->nkids++;
+    return true;
+}
+
+static void kid_remove(dnode_t *node, dnode_t **slot)
+{
+    uint32_t mask = node->kcap - 1;
+    uint32_t i = (uint32_t)(slot - node->kids);
+    for (uint32_t j = (i + 1) & mask; node->kids[j]; j = (j + 1) & mask)
+    {
+        if (slot_movable(i, j, (uint32_t)node->kids[j]->hash & mask))
+        {
+            node->kids[i] = node->kids[j];
+            i = j;
+        }
+    }
+    node->kids[i] = NULL;
+    node->nkids--;
+}
+
+static fent_t *fent_slot(fent_t *v, uint32_t cap, uint64_t hash)
+{
+    uint32_t i = (uint32_t)hash & (cap - 1);
+    while (v[i].hash != hash && v[i].hash != FENT_EMPTY)
+        i = (i + 1) & (cap - 1);
+    return &v[i];
+}
+
+static bool fent_grow(dnode_t *node)
+{
+    uint32_t cap = node->fcap ? node->fcap * 2 : INIT_CAP;
+    fent_t *v = calloc(cap, sizeof(fent_t));
+    if (!v) return false;
+
+    for (uint32_t i = 0; i < node->fcap; i++)
+        if (node->files[i].hash != FENT_EMPTY)
+            *fent_slot(v, cap, node->files[i].hash) = node->files[i];
+
+    free(node->files);
+    node->files = v;
+    node->fcap = cap;
+    return true;
+}
+
+// the entry for `hash`, or NULL
+static fent_t *fent_find(const dnode_t *node, uint64_t hash)
+{
+    if (!node->fcap) return NULL;
+    fent_t *e = fent_slot(node->files, node->fcap, hash);
+    return e->hash == hash ? e : NULL;
+}
+
+// add a file, or set its size if `hash` is there already
+static bool fent_put(dnode_t *node, uint64_t hash, uint64_t size)
+{
+    if ((node->nfiles + 1) * 4 > node->fcap * 3 && !fent_grow(node))
+        return false;
+
+    fent_t *e = fent_slot(node->files, node->fcap, hash);
+    if (e->hash == FENT_EMPTY) node->nfiles++;
+    *e = (fent_t){ .hash = hash, .size = size };
+    return true;
+}
+
+static void fent_remove(dnode_t *node, fent_t *e)
+{
+    uint32_t mask = node->fcap - 1;
+    uint32_t i = (uint32_t)(e - node->files);
+    for (uint32_t j = (i + 1) & mask; node->files[j].hash != FENT_EMPTY;
+         j = (j + 1) & mask)
+    {
+        if (slot_movable(i, j, (uint32_t)node->files[j].hash & mask))
+        {
+            node->files[i] = node->files[j];
+            i = j;
+        }
+    }
+    node->files[i].hash = FENT_EMPTY;
+    node->nfiles--;
+}
+
+// full path of `node` into a malloc'd string
+static char *node_path(const dnode_t *node, const char *name)
+{
+    size_t len = name ? strlen(name) + 1 : 0;
+    for (const dnode_t *n = node; n; n = n->parent) len += strlen(n->name) + 1;
+
+    char *path = malloc(len + 1);
+    if (!path) return NULL;
+
+    char *end = path + len;
+    *end = '\0';
+    if (name)
+    {
+        size_t l = strlen(name);
+        end -= l;
+        memcpy(end, name, l);
+        *--end = '/';
+    }
+    for (const dnode_t *n = node; n; n = n->parent)
+    {
+        size_t l = strlen(n->name);
+        end -= l;
+        memcpy(end, n->name, l);
+        if (n->parent) *--end = '/';
+    }
+
+    // a root of "/" leaves a doubled separator below it
+    if (end > path) memmove(path, end, strlen(end) + 1);
+    if (path[0] == '/' && path[1] == '/') memmove(path, path + 1, strlen(path));
+    return path;
+}
+
+static void watch(dstate_t *ds, dnode_t *node, const char *path)
+{
+    int wd = inotify_add_watch(ds->ifd, path, WATCH_MASK);
+    if (wd < 0)
+    {
+    #ifdef _OPENMP
+        #pragma omp critical(print)
+    #endif
+        if (!ds->warned)
+        {
+            ds->warned = true;
+            fprintf(stderr,
+                    "Warning: cannot watch '%s': %s; changes below it will "
+                    "be missed (see /proc/sys/fs/inotify/max_user_watches)\n",
+                    path,
+                    strerror(errno));
+        }
+        return;
+    }
+
+    #ifdef _OPENMP
+        #pragma omp critical(daemon_wd)
+    #endif
+    {
+        if (wd >= ds->wdcap)
+        {
+            int cap = ds->wdcap ? ds->wdcap : 1024;
+            while (cap <= wd) cap *= 2;
+            dnode_t **bywd = realloc(ds->bywd, cap * sizeof(dnode_t *));
+            if (bywd)
+            {
+                memset(bywd + ds->wdcap, 0, (cap - ds->wdcap) * sizeof(*bywd));
+                ds->bywd = bywd;
+                ds->wdcap = cap;
+            }
+        }
+        if (wd < ds->wdcap)
+        {
+            // the same inode watched again (e.g. a directory moved before
+            // its old entry was dropped) hands back the same descriptor
+            if (ds->bywd[wd] && ds->bywd[wd] != node) ds->bywd[wd]->wd = -1;
+            ds->bywd[wd] = node;
+            node->wd = wd;
+        }
+    }
+}
+
+UDU_SI int node_depth(const dnode_t *node)
+{
+    int depth = 0;
+    for (; node->parent; node = node->parent) depth++;
+    return depth;
+}
+
+// fill `node`, `depth` levels below its root, from disk; as in walk(),
+// subdirectories are built as parallel tasks and summed after taskwait,
+// and what can't be read is a failure, not part of the totals
+static void build(dstate_t *ds, dnode_t *node, const char *path, int depth)
+{
+    watch(ds, node, path);
+
+    platform_dir_t *dir = platform_opendir(path);
+    if (!dir)
+    {
+        fail(ds, path, errno);
+        return;
+    }
+
+    size_t plen = strlen(path);
+    bool slash = plen > 0 && path[plen - 1] == '/';
+    const char *entry;
+    while ((entry = platform_readdir(dir)))
+    {
+        size_t elen = strlen(entry);
+        char *full = malloc(plen + elen + 2);
+        if (!full) continue;
+        memcpy(full, path, plen);
+        if (!slash) full[plen] = '/';
+        memcpy(full + plen + !slash, entry, elen + 1);
+
+        platform_stat_t st;
+        bool ok = !excluded(ds, entry, full);
+        if (ok && !platform_stat_at(dir, entry, full, &st))
+        {
+            fail(ds, full, errno);
+            ok = false;
+        }
+        // too deep to descend: a failure, not a directory in the totals
+        if (ok && st.is_directory && depth + 1 > MAX_DEPTH)
+        {
+            fail(ds, full, UDU_ERR_DEPTH);
+            ok = false;
+        }
+        if (!ok || st.type == 'l')
+        {
+            free(full);
+            continue;
+        }
+
+        if (!st.is_directory)
+        {
+            uint64_t size = ds->cfg->apparent_size ? st.size_apparent
+                                                   : st.size_allocated;
+            fent_put(node, name_hash(entry, strlen(entry)), size);
+            free(full);
+            continue;
+        }
+
+        dnode_t *kid = dnode_new(entry, node);
+        if (!kid || !kid_add(node, kid))
+        {
+            free(kid);
+            free(full);
+            continue;
+        }
+
+    #ifdef _OPENMP
+        #pragma omp task firstprivate(kid, full, depth)
+    #endif
+        {
+            build(ds, kid, full, depth + 1);
+            free(full);
+        }
+    }
+
+    #ifdef _OPENMP
+        #pragma omp taskwait
+    #endif
+    platform_closedir(dir);
+
+    for (uint32_t i = 0; i < node->fcap; i++)
+        node->size += node->files[i].size; // free slots hold 0
+    node->tfiles += node->nfiles;
+    for (uint32_t i = 0; i < node->kcap; i++)
+    {
+        const dnode_t *kid = node->kids[i];
+        if (!kid) continue;
+        node->size += kid->size;
+        node->tfiles += kid->tfiles;
+        node->tdirs += kid->tdirs;
+    }
+}
+
+static void dnode_free(dstate_t *ds, dnode_t *node)
+{
+    for (uint32_t i = 0; i < node->kcap; i++)
+        if (node->kids[i]) dnode_free(ds, node->kids[i]);
+
+    if (node->wd >= 0 && node->wd < ds->wdcap && ds->bywd[node->wd] == node)
+    {
+        inotify_rm_watch(ds->ifd, node->wd);
+        ds->bywd[node->wd] = NULL;
+    }
+    free(node->kids);
+    free(node->files);
+    free(node->name);
+    free(node);
+}
+
+static void propagate(dnode_t *node,
+                      int64_t dsize,
+                      int64_t dfiles,
+                      int64_t ddirs)
+{
+    for (; node; node = node->parent)
+    {
+        node->size += (uint64_t)dsize;
+        node->tfiles += (uint64_t)dfiles;
+        node->tdirs += (uint64_t)ddirs;
+    }
+}
+
+static void kid_drop(dstate_t *ds, dnode_t *node, dnode_t **slot)
+{
+    dnode_t *kid = *slot;
+    propagate(node,
+              -(int64_t)kid->size,
+              -(int64_t)kid->tfiles,
+              -(int64_t)kid->tdirs);
+    kid_remove(node, slot);
+    dnode_free(ds, kid);
+}
+
+// bring one name in `node` in line with the filesystem
+static void refresh(dstate_t *ds, dnode_t *node, const char *name)
+{
+    char *path = node_path(node, name);
+    if (!path) return;
+
+    platform_stat_t st = { 0 };
+    bool exists = false;
+    if (!excluded(ds, name, path) && !is_symlink(path))
+    {
+        exists = platform_stat(path, &st);
+        // gone again is the common case; anything else is a failure
+        if (!exists && errno != ENOENT && errno != ENOTDIR)
+            fail(ds, path, errno);
+    }
+
+    size_t len = strlen(name);
+    uint64_t hash = name_hash(name, len);
+    fent_t *file = fent_find(node, hash);
+    dnode_t **kid_at = kid_find(node, name, len);
+
+    if (file && (!exists || st.is_directory))
+    {
+        propagate(node, -(int64_t)file->size, -1, 0);
+        fent_remove(node, file);
+        file = NULL;
+    }
+
+    if (kid_at && (!exists || !st.is_directory))
+    {
+        kid_drop(ds, node, kid_at);
+        kid_at = NULL;
+    }
+
+    int depth = node_depth(node) + 1;
+    if (exists && st.is_directory && !kid_at && depth > MAX_DEPTH)
+    {
+        fail(ds, path, UDU_ERR_DEPTH);
+    }
+    else if (exists && st.is_directory && !kid_at)
+    {
+        dnode_t *kid = dnode_new(name, node);
+        if (kid && kid_add(node, kid))
+        {
+            build(ds, kid, path, depth);
+            propagate(node,
+                      (int64_t)kid->size,
+                      (int64_t)kid->tfiles,
+                      (int64_t)kid->tdirs);
+        }
+        else
+        {
+            free(kid);
+        }
+    }
+    else if (exists && !st.is_directory)
+    {
+        uint64_t size =
+          ds->cfg->apparent_size ? st.size_apparent : st.size_allocated;
+        if (file)
+        {
+            propagate(node, (int64_t)(size - file->size), 0, 0);
+            file->size = size;
+        }
+        else if (fent_put(node, hash, size))
+        {
+            propagate(node, (int64_t)size, 1, 0);
+        }
+    }
+
+    free(path);
+}
+
+static int pending_cmp(const void *a, const void *b)
+{
+    const pending_t *pa = a;
+    const pending_t *pb = b;
+    if (pa->wd != pb->wd) return pa->wd < pb->wd ? -1 : 1;
+    return pa->hash < pb->hash ? -1 : pa->hash > pb->hash;
+}
+
+static void scan_all(dstate_t *ds)
+{
+    #ifdef _OPENMP
+        #pragma omp parallel
+        #pragma omp single
+    #endif
+    for (int i = 0; i < ds->nroots; i++)
+    {
+        dnode_t *root = ds->roots[i];
+    #ifdef _OPENMP
+        #pragma omp task firstprivate(root)
+    #endif
+        build(ds, root, root->name, 0);
+    }
+}
+
+static bool add_roots(dstate_t *ds)
+{
+    ds->roots = calloc(ds->cfg->path_count, sizeof(dnode_t *));
+    if (!ds->roots) return false;
+
+    for (int i = 0; i < ds->cfg->path_count; i++)
+    {
+        char *real = realpath(ds->cfg->paths[i], NULL);
+        if (!real || !platform_is_directory(real))
+        {
+            fprintf(stderr,
+                    "Error: '%s' is not a directory\n",
+                    ds->cfg->paths[i]);
+            free(real);
+            continue;
+        }
+        dnode_t *root = dnode_new(real, NULL);
+        free(real);
+        if (root) ds->roots[ds->nroots++] = root;
+    }
+    return ds->nroots > 0;
+}
+
+static void rescan(dstate_t *ds)
+{
+    fprintf(stderr, "udu: inotify queue overflowed, rescanning\n");
+    for (int i = 0; i < ds->nroots; i++)
+    {
+        dnode_t *root = ds->roots[i];
+        ds->roots[i] = dnode_new(root->name, NULL);
+        dnode_free(ds, root);
+    }
+    scan_all(ds);
+}
+
+static void handle_events(dstate_t *ds)
+{
+    static char evbuf[EVENT_BUF]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+    pending_t *pend = NULL;
+    size_t npend = 0, pcap = 0;
+    bool overflow = false;
+
+    ssize_t len;
+    while ((len = read(ds->ifd, evbuf, sizeof(evbuf))) > 0)
+    {
+        for (char *p = evbuf; p < evbuf + len;)
+        {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) overflow = true;
+            if (ev->mask & IN_IGNORED)
+            {
+                if (ev->wd >= 0 && ev->wd < ds->wdcap && ds->bywd[ev->wd])
+                {
+                    ds->bywd[ev->wd]->wd = -1;
+                    ds->bywd[ev->wd] = NULL;
+                }
+                continue;
+            }
+            if (!ev->len || ev->wd < 0 || ev->wd >= ds->wdcap ||
+                !ds->bywd[ev->wd])
+                continue;
+
+            if (npend >= pcap)
+            {
+                size_t cap = pcap ? pcap * 2 : 256;
+                pending_t *v = realloc(pend, cap * sizeof(pending_t));
+                if (!v) break;
+                pend = v;
+                pcap = cap;
+            }
+            char *name = strdup(ev->name);
+            if (!name) break;
+            uint64_t hash = name_hash(name, strlen(name));
+            pend[npend++] =
+              (pending_t){ .wd = ev->wd, .hash = hash, .name = name };
+        }
+    }
+
+    // one stat per (directory, name) however many events it produced;
+    // each refresh looks at the current state, so order doesn't matter
+    if (npend > 1) qsort(pend, npend, sizeof(pending_t), pending_cmp);
+
+    for (size_t i = 0; i < npend; i++)
+    {
+        bool dup = i > 0 && pend[i].wd == pend[i - 1].wd &&
+                   pend[i].hash == pend[i - 1].hash;
+        // dnode_free() clears the slot of every node it releases, and
+        // the kernel does not hand out a freed descriptor again soon
+        dnode_t *node = ds->bywd[pend[i].wd];
+        if (!dup && !overflow && node) refresh(ds, node, pend[i].name);
+        free(pend[i].name);
+    }
+    free(pend);
+
+    if (overflow) rescan(ds);
+    report_errors(ds);
+}
+
+static const dnode_t *lookup(const dstate_t *ds, const char *path)
+{
+    for (int i = 0; i < ds->nroots; i++)
+    {
+        const dnode_t *node = ds->roots[i];
+        size_t rl = strlen(node->name);
+        if (strncmp(path, node->name, rl) != 0) continue;
+        if (path[rl] && path[rl] != '/' && !(rl == 1 && node->name[0] == '/'))
+            continue;
+
+        const char *p = path + rl;
+        while (node && *p)
+        {
+            while (*p == '/') p++;
+            if (!*p) break;
+
+            const char *end = strchr(p, '/');
+            size_t l = end ? (size_t)(end - p) : strlen(p);
+            dnode_t **slot = kid_find(node, p, l);
+            node = slot ? *slot : NULL;
+            p += l;
+        }
+        if (node) return node;
+    }
+    return NULL;
+}
+
+static void answer(const dstate_t *ds, int fd, const char *query)
+{
+    char reply[128];
+    int n;
+
+    if (!*query)
+    {
+        uint64_t size = 0, files = 0, dirs = 0;
+        for (int i = 0; i < ds->nroots; i++)
+        {
+            size += ds->roots[i]->size;
+            files += ds->roots[i]->tfiles;
+            dirs += ds->roots[i]->tdirs;
+        }
+        n = snprintf(reply, sizeof(reply), "%lu %lu %lu\n", size, files, dirs);
+    }
+    else
+    {
+        const dnode_t *node = lookup(ds, query);
+        if (node)
+            n = snprintf(reply,
+                         sizeof(reply),
+                         "%lu %lu %lu\n",
+                         node->size,
+                         node->tfiles,
+                         node->tdirs);
+        else
+            n = snprintf(reply, sizeof(reply), "ERR not found\n");
+    }
+
+    if (write(fd, reply, (size_t)n) < 0)
+    {
+        // the client went away; poll() reports the hangup next
+    }
+}
+
+// returns false once the client should be dropped
+static bool serve(const dstate_t *ds, client_t *c)
+{
+    ssize_t r = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+    if (r <= 0) return false;
+    c->len += (size_t)r;
+
+    char *nl;
+    while ((nl = memchr(c->buf, '\n', c->len)))
+    {
+        *nl = '\0';
+        size_t l = (size_t)(nl - c->buf);
+        while (l > 1 && c->buf[l - 1] == '/') c->buf[--l] = '\0';
+        answer(ds, c->fd, c->buf);
+
+        size_t used = (size_t)(nl - c->buf) + 1;
+        memmove(c->buf, nl + 1, c->len - used);
+        c->len -= used;
+    }
+
+    // a line longer than PATH_MAX can't be a valid query
+    return c->len < sizeof(c->buf) - 1;
+}
+
+static const char *socket_path(const args_t *cfg, char *buf, size_t len)
+{
+    if (cfg->socket_path) return cfg->socket_path;
+
+    const char *run = getenv("XDG_RUNTIME_DIR");
+    if (run && *run)
+        snprintf(buf, len, "%s/udu.sock", run);
+    else
+        snprintf(buf, len, "/tmp/udu-%u.sock", (unsigned)getuid());
+    return buf;
+}
+
+// clear `path` for bind(): only a stale socket, one nobody answers on,
+// is removed; any other file or a running daemon is left alone
+static bool socket_clear(const char *path, const struct sockaddr_un *addr)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0)
+    {
+        if (errno == ENOENT) return true;
+        fprintf(stderr,
+                "Error: cannot access '%s': %s\n",
+                path,
+                strerror(errno));
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        fprintf(stderr, "Error: '%s' exists and is not a socket\n", path);
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    bool live = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+    close(fd);
+    if (live)
+    {
+        fprintf(stderr, "Error: a daemon is already listening on '%s'\n", path);
+        return false;
+    }
+    return unlink(path) == 0 || errno == ENOENT;
+}
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Error: socket path '%s' is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    if (!socket_clear(path, &addr)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0)
+    {
+        fprintf(stderr,
+                "Error: cannot listen on '%s': %s\n",
+                path,
+                strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int daemon_run(const args_t *cfg)
+{
+    dstate_t ds = { .cfg = cfg };
+    char sockbuf[PATH_MAX];
+    const char *sock = socket_path(cfg, sockbuf, sizeof(sockbuf));
+
+    ds.ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ds.ifd < 0)
+    {
+        fprintf(stderr, "Error: inotify: %s\n", strerror(errno));
+        return 1;
+    }
+    if (!add_roots(&ds))
+    {
+        close(ds.ifd);
+        return 1;
+    }
+
+    int lfd = listen_on(sock);
+    if (lfd < 0)
+    {
+        close(ds.ifd);
+        return 1;
+    }
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    scan_all(&ds);
+
+    uint64_t dirs = 0;
+    for (int i = 0; i < ds.nroots; i++) dirs += ds.roots[i]->tdirs;
+    fprintf(stderr,
+            "udu: watching %lu directories, listening on %s\n",
+            dirs,
+            sock);
+    report_errors(&ds);
+
+    client_t *clients = calloc(MAX_CLIENTS, sizeof(client_t));
+    struct pollfd pfd[MAX_CLIENTS + 2];
+    int nclients = 0;
+
+    while (!stop && clients)
+    {
+        pfd[0] = (struct pollfd){ .fd = ds.ifd, .events = POLLIN };
+        pfd[1] = (struct pollfd){ .fd = lfd, .events = POLLIN };
+        for (int i = 0; i < nclients; i++)
+            pfd[i + 2] = (struct pollfd){ .fd = clients[i].fd,
+                                          .events = POLLIN };
+
+        if (poll(pfd, (nfds_t)nclients + 2, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfd[0].revents & POLLIN) handle_events(&ds);
+
+        // serve before accepting so indices still match pfd
+        for (int i = nclients - 1; i >= 0; i--)
+        {
+            if (!pfd[i + 2].revents) continue;
+            if (!(pfd[i + 2].revents & POLLIN) || !serve(&ds, &clients[i]))
+            {
+                close(clients[i].fd);
+                clients[i] = clients[--nclients];
+            }
+        }
+
+        if (pfd[1].revents & POLLIN)
+        {
+            int cfd = accept(lfd, NULL, NULL);
+            if (cfd >= 0 && nclients < MAX_CLIENTS)
+                clients[nclients++] = (client_t){ .fd = cfd };
+            else if (cfd >= 0)
+                close(cfd);
+        }
+    }
+
+    for (int i = 0; i < nclients; i++) close(clients[i].fd);
+    free(clients);
+    close(lfd);
+    unlink(sock);
+    for (int i = 0; i < ds.nroots; i++) dnode_free(&ds, ds.roots[i]);
+    free(ds.roots);
+    free(ds.bywd);
+    walk_result_free(&ds.errs);
+    close(ds.ifd);
+    return 0;
+}
+
+int daemon_query(const args_t *cfg)
+{
+    char sockbuf[PATH_MAX];
+    const char *sock = socket_path(cfg, sockbuf, sizeof(sockbuf));
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(sock) >= sizeof(addr.sun_path)) return 1;
+    strcpy(addr.sun_path, sock);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        fprintf(stderr, "Error: cannot connect to '%s'\n", sock);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+
+    // the daemon keys its tree by resolved paths
+    char *real = realpath(cfg->query, NULL);
+    const char *path = real ? real : cfg->query;
+    size_t len = strlen(path);
+    char reply[128];
+    ssize_t n = -1;
+
+    if (write(fd, path, len) == (ssize_t)len && write(fd, "\n", 1) == 1)
+        n = read(fd, reply, sizeof(reply) - 1);
+    close(fd);
+
+    unsigned long long size, files, dirs;
+    if (n <= 0)
+    {
+        fprintf(stderr, "Error: no reply from '%s'\n", sock);
+        free(real);
+        return 1;
+    }
+    reply[n] = '\0';
+    if (sscanf(reply, "%llu %llu %llu", &size, &files, &dirs) != 3)
+    {
+        fprintf(stderr, "Error: '%s': %s", path, reply);
+        free(real);
+        return 1;
+    }
+
+    char size_str[32];
+    printf("%s %s (%llu files, %llu directories)\n",
+           path,
+           human_size(size, size_str, sizeof(size_str)),
+           files,
+           dirs);
+    free(real);
+    return 0;
+}
+
+#else
+
+int daemon_run(const args_t *cfg)
+{
+    (void)cfg;
+    fprintf(stderr, "Error: --daemon is only supported on Linux\n");
+    return 1;
+}
+
+int daemon_query(const args_t *cfg)
+{
+    (void)cfg;
+    fprintf(stderr, "Error: --query is only supported on Linux\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef UDU_DAEMON_H
+#define UDU_DAEMON_H
+
+#include "args.h"
+
+// --daemon: scan cfg->paths once, keep the totals current through
+// inotify and answer queries on cfg->socket_path until SIGINT/SIGTERM
+int daemon_run(const args_t *cfg);
+
+// --query: ask a running daemon for the totals of cfg->query
+int daemon_query(const args_t *cfg);
+
+#endif
@@ -7,9 +7,178 @@
 ////
 
 #include "args.h"
+#include "daemon.h"
+#include "platform.h"
+#include "snapshot.h"
 #include "util.h"
 #include "walk.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// column heading of age bucket `b`
+static void print_age_label(const args_t *args, int b)
+{
+    char label[32];
+    int n = args->age_count;
+
+    if (b == 0)
+        snprintf(label, sizeof(label), "<%dd", args->age_days[0]);
+    else if (b == n)
+        snprintf(label, sizeof(label), ">=%dd", args->age_days[n - 1]);
+    else
+        snprintf(label,
+                 sizeof(label),
+                 "%d-%dd",
+                 args->age_days[b - 1],
+                 args->age_days[b]);
+    printf("%-10s", label);
+}
+
+// one row of bytes per root (when there are several) plus total bytes and
+// file counts, one column per age bucket
+static void print_ages(const args_t *args, const udu_result_t *res)
+{
+    char label[32], size_str[32];
+    int n = args->age_count;
+
+    printf("\nAge (%ctime):\n", args->age_time);
+    for (int b = 0; b <= n; b++) print_age_label(args, b);
+    printf("\n");
+
+    for (int i = 0; res->nroots > 1 && i < res->nroots; i++)
+    {
+        const udu_root_t *root = &res->roots[i];
+        if (!root->ok) continue;
+        for (int b = 0; b <= n; b++)
+            printf("%-10s",
+                   human_size(
+                     root->agg.age_size[b], size_str, sizeof(size_str)));
+        printf("%s\n", root->path);
+    }
+
+    for (int b = 0; b <= n; b++)
+        printf("%-10s",
+               human_size(res->total.age_size[b], size_str, sizeof(size_str)));
+    printf("total\n");
+    for (int b = 0; b <= n; b++)
+    {
+        snprintf(label, sizeof(label), "%lu", res->total.age_files[b]);
+        printf("%-10s", label);
+    }
+    printf("files\n");
+}
+
+static void print_owners(const udu_owner_t *v, int n, bool group)
+{
+    char size_str[32], name[256];
+
+    printf("\n%-8s %10s %s\n", "SIZE", "FILES", group ? "GROUP" : "USER");
+    for (int i = 0; i < n; i++)
+        printf("%-8s %10lu %s\n",
+               human_size(v[i].size, size_str, sizeof(size_str)),
+               v[i].nfiles,
+               platform_owner_name(v[i].id, group, name, sizeof(name)));
+}
+
+static void print_changes(const char *file,
+                          const snap_change_t *v,
+                          size_t n)
+{
+    char delta_str[32], size_str[32];
+
+    printf("\nChanged since %s:\n", file);
+    printf("%-9s %-8s %s\n", "CHANGE", "SIZE", "PATH");
+    for (size_t i = 0; i < n; i++)
+    {
+        bool grew = v[i].new_size >= v[i].old_size;
+        uint64_t delta = grew ? v[i].new_size - v[i].old_size
+                              : v[i].old_size - v[i].new_size;
+        printf("%c%-8s %-8s %s\n",
+               grew ? '+' : '-',
+               human_size(delta, delta_str, sizeof(delta_str)),
+               human_size(v[i].new_size, size_str, sizeof(size_str)),
+               v[i].path);
+    }
+}
+
+// du order: a directory follows everything below it; '/' sorts before
+// any other byte so each subtree stays contiguous. A path that ends
+// sorts after a longer one only when that one continues with '/' (a
+// descendant); before any other byte, as a sibling like "a-b" follows
+// all of "a"
+static int du_cmp(const void *a, const void *b)
+{
+    const char *pa = (*(const udu_dir_t *const *)a)->path;
+    const char *pb = (*(const udu_dir_t *const *)b)->path;
+    while (*pa && *pa == *pb) pa++, pb++;
+
+    if (!*pa && !*pb) return 0;
+    if (!*pa) return *pb == '/' ? 1 : -1;
+    if (!*pb) return *pa == '/' ? -1 : 1;
+    unsigned char ca = *pa == '/' ? 0 : (unsigned char)*pa;
+    unsigned char cb = *pb == '/' ? 0 : (unsigned char)*pb;
+    return ca < cb ? -1 : 1;
+}
+
+// with --sparse each line shows apparent, allocated and saved bytes in
+// place of the size; with --age-buckets it also splits the size by age
+static void print_depth(const args_t *args, const udu_result_t *res)
+{
+    const udu_dir_t **v = malloc((res->ndir_list + 1) * sizeof(*v));
+    if (!v) return;
+
+    size_t n = 0;
+    for (size_t i = 0; i < res->ndir_list; i++)
+        if (res->dir_list[i].depth <= args->max_depth)
+            v[n++] = &res->dir_list[i];
+    if (n > 1) qsort(v, n, sizeof(*v), du_cmp);
+
+    char size_str[32], alloc_str[32], saved_str[32];
+    int nages = args->age_count;
+    printf("\n");
+    if (nages || args->sparse)
+    {
+        if (args->sparse)
+            printf("%-8s %-8s %-8s ", "APPARENT", "ALLOC", "SAVED");
+        else
+            printf("%-8s ", "SIZE");
+        for (int b = 0; nages && b <= nages; b++) print_age_label(args, b);
+        printf("PATH\n");
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        const udu_agg_t *agg = &v[i]->agg;
+        if (args->sparse)
+            printf("%-8s %-8s %-8s ",
+                   human_size(agg->apparent, size_str, sizeof(size_str)),
+                   human_size(agg->allocated, alloc_str, sizeof(alloc_str)),
+                   human_size(agg->sparse, saved_str, sizeof(saved_str)));
+        else
+            printf("%-8s ", human_size(agg->size, size_str, sizeof(size_str)));
+        for (int b = 0; nages && b <= nages; b++)
+            printf("%-10s",
+                   human_size(agg->age_size[b], size_str, sizeof(size_str)));
+        printf("%s\n", v[i]->path);
+    }
+    free(v);
+}
+
+// -v: file lines arrive in per-thread batches, one lock per batch
+static void print_entries(const udu_entry_t *v, size_t n, void *user)
+{
+    (void)user;
+#ifdef _OPENMP
+    #pragma omp critical(print)
+#endif
+    {
+        char size_str[32];
+        for (size_t i = 0; i < n; i++)
+            printf("%-8s %s\n",
+                   human_size(v[i].size, size_str, sizeof(size_str)),
+                   v[i].path);
+    }
+}
 
 int main(int argc, char **argv)
 {
@@ -36,14 +205,127 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    walk_result_t result = walk_paths(&args);
+    if (args.daemon || args.query)
+    {
+        int rc = args.daemon ? daemon_run(&args) : daemon_query(&args);
+        args_free(&args);
+        return rc;
+    }
+
+    udu_visitor_t verbose = { .on_entry = print_entries };
+    udu_result_t result =
+      walk_paths(&args, args.verbose && !args.tree ? &verbose : NULL);
+    int status = 0;
 
     char size_str[32];
+
+    if (args.max_depth >= 0) print_depth(&args, &result);
+
+    // per-root totals; tree mode already shows each root as its own header
+    // and a depth listing already has a line for each root
+    if (result.nroots > 1 && !args.tree && args.max_depth < 0)
+    {
+        printf("\n");
+        if (args.sparse)
+            printf(
+              "%-8s %-8s %-8s %s\n", "APPARENT", "ALLOC", "SAVED", "PATH");
+        for (int i = 0; i < result.nroots; i++)
+        {
+            const udu_root_t *root = &result.roots[i];
+            if (!root->ok) continue;
+            if (args.sparse)
+            {
+                const udu_agg_t *agg = &root->agg;
+                char alloc_str[32], saved_str[32];
+                printf("%-8s %-8s %-8s %s\n",
+                       human_size(agg->apparent, size_str, sizeof(size_str)),
+                       human_size(agg->allocated, alloc_str, sizeof(alloc_str)),
+                       human_size(agg->sparse, saved_str, sizeof(saved_str)),
+                       root->path);
+            }
+            else
+            {
+                printf("%-8s %s\n",
+                       human_size(root->agg.size, size_str, sizeof(size_str)),
+                       root->path);
+            }
+        }
+    }
+
+    if (result.ntop_files > 0)
+    {
+        printf("\nLargest files:\n");
+        for (int i = 0; i < result.ntop_files; i++)
+            printf("%-8s %s\n",
+                   human_size(result.top_files[i].size,
+                              size_str,
+                              sizeof(size_str)),
+                   result.top_files[i].path);
+    }
+
+    if (result.ntop_dirs > 0)
+    {
+        printf("\nLargest directories:\n");
+        for (int i = 0; i < result.ntop_dirs; i++)
+            printf("%-8s %s\n",
+                   human_size(result.top_dirs[i].size,
+                              size_str,
+                              sizeof(size_str)),
+                   result.top_dirs[i].path);
+    }
+
+    if (args.age_count > 0) print_ages(&args, &result);
+    if (args.by_user) print_owners(result.users, result.nusers, false);
+    if (args.by_group) print_owners(result.groups, result.ngroups, true);
+
+    // diff before saving so --diff and --save-snapshot may name one file
+    if (args.diff)
+    {
+        snap_change_t *changes;
+        size_t nchanges;
+        if (snapshot_diff(args.diff,
+                          &result,
+                          args.apparent_size,
+                          args.diff_threshold,
+                          &changes,
+                          &nchanges))
+        {
+            print_changes(args.diff, changes, nchanges);
+            snapshot_changes_free(changes, nchanges);
+        }
+        else
+        {
+            status = 1;
+        }
+    }
+
+    if (args.save_snapshot &&
+        !snapshot_save(args.save_snapshot, &result, args.apparent_size))
+        status = 1;
+
     printf("\nTotal: %s (%lu files, %lu directories)\n",
-           human_size(result.total_size, size_str, sizeof(size_str)),
-           result.nfiles,
-           result.ndirs);
+           human_size(result.total.size, size_str, sizeof(size_str)),
+           result.total.nfiles,
+           result.total.ndirs);
+
+    if (args.sparse)
+    {
+        char alloc_str[32], saved_str[32];
+        printf("Apparent: %s, allocated: %s, sparse savings: %s "
+               "(%lu sparse files)\n",
+               human_size(result.total.apparent, size_str, sizeof(size_str)),
+               human_size(result.total.allocated, alloc_str, sizeof(alloc_str)),
+               human_size(result.total.sparse, saved_str, sizeof(saved_str)),
+               result.total.nsparse);
+    }
+
+    if (result.nfailed)
+    {
+        walk_print_errors(&result);
+        status = 1;
+    }
 
+    walk_result_free(&result);
     args_free(&args);
-    return 0;
+    return status;
 }
@@ -0,0 +1,16 @@
+#
+# Profile-guided optimization flags for `make pgo`
+#
+PGO_DIR   := $(CURDIR)/.pgo
+PGO_CLANG := $(shell $(CC) --version 2>/dev/null | grep -q clang && echo yes)
+
+ifeq ($(PGO_CLANG),yes)
+    PGO_GEN   := -fprofile-generate=$(PGO_DIR)
+    PGO_USE   := -fprofile-use=$(PGO_DIR)/udu.profdata
+    PGO_MERGE := llvm-profdata merge -o $(PGO_DIR)/udu.profdata $(PGO_DIR)
+else
+    # threads update the counters concurrently during training
+    PGO_GEN   := -fprofile-generate=$(PGO_DIR) -fprofile-update=atomic
+    PGO_USE   := -fprofile-use=$(PGO_DIR) -fprofile-correction
+    PGO_MERGE := true
+endif
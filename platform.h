@@ -7,13 +7,30 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <sys/stat.h>
 
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <grp.h>
+    #include <pwd.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #include <malloc.h>
+#endif
+
 typedef struct
 {
     bool is_directory;
+    char type; // PLATFORM_TYPES letter, or 0 when unknown
     uint64_t size_apparent;
     uint64_t size_allocated;
+    int64_t mtime;
+    int64_t atime;
+    int64_t ctime;
+    uint32_t uid;
+    uint32_t gid;
 } platform_stat_t;
 
 typedef struct
@@ -24,23 +41,51 @@ typedef struct
 
 #define BLOCK_SIZE 512
 
-UDU_SI bool platform_stat(const char *path, platform_stat_t *st)
+// file type letters, as in find -type: regular, directory, symlink,
+// block device, character device, fifo, socket
+#define PLATFORM_TYPES "fdlbcps"
+
+UDU_SI char platform_mode_type(mode_t mode)
 {
-    struct stat sb;
-    if (stat(path, &sb) != 0)
-    {
-        return false;
-    }
+    if (S_ISREG(mode)) return 'f';
+    if (S_ISDIR(mode)) return 'd';
+#ifndef _WIN32
+    if (S_ISLNK(mode)) return 'l';
+    if (S_ISBLK(mode)) return 'b';
+    if (S_ISFIFO(mode)) return 'p';
+    if (S_ISSOCK(mode)) return 's';
+#endif
+    if (S_ISCHR(mode)) return 'c';
+    return 0;
+}
 
-    st->is_directory = S_ISDIR(sb.st_mode);
-    st->size_apparent = (uint64_t)sb.st_size;
+UDU_SI void platform_fill_stat(platform_stat_t *st, const struct stat *sb)
+{
+    st->is_directory = S_ISDIR(sb->st_mode);
+    st->type = platform_mode_type(sb->st_mode);
+    st->size_apparent = (uint64_t)sb->st_size;
+    st->mtime = (int64_t)sb->st_mtime;
+    st->atime = (int64_t)sb->st_atime;
+    st->ctime = (int64_t)sb->st_ctime;
+    st->uid = (uint32_t)sb->st_uid;
+    st->gid = (uint32_t)sb->st_gid;
 
 #if defined(__APPLE__) || defined(__linux__) // BSDs....??
-    st->size_allocated = (uint64_t)sb.st_blocks * BLOCK_SIZE;
+    st->size_allocated = (uint64_t)sb->st_blocks * BLOCK_SIZE;
 #else
     st->size_allocated = st->size_apparent;
 #endif
+}
+
+UDU_SI bool platform_stat(const char *path, platform_stat_t *st)
+{
+    struct stat sb;
+    if (stat(path, &sb) != 0)
+    {
+        return false;
+    }
 
+    platform_fill_stat(st, &sb);
     return true;
 }
 
@@ -50,7 +95,7 @@ UDU_SI bool platform_is_directory(const char *path)
     return stat(path, &sb) == 0 && S_ISDIR(sb.st_mode);
 }
 
-uint64_t platform_file_size(const char *path, bool apparent)
+UDU_SI uint64_t platform_file_size(const char *path, bool apparent)
 {
     platform_stat_t st;
     return platform_stat(path, &st)
@@ -91,6 +136,71 @@ UDU_SI const char *platform_readdir(platform_dir_t *dir)
     return NULL;
 }
 
+// inode number of the entry platform_readdir() last returned; 0 where
+// the platform does not report one
+UDU_SI uint64_t platform_dir_ino(const platform_dir_t *dir)
+{
+#ifndef _WIN32
+    return dir && dir->entry ? (uint64_t)dir->entry->d_ino : 0;
+#else
+    (void)dir;
+    return 0;
+#endif
+}
+
+// type of the entry platform_readdir() last returned, from d_type where
+// the filesystem fills it in; 0 means stat() has to tell
+UDU_SI char platform_dir_type(const platform_dir_t *dir)
+{
+#ifdef DT_UNKNOWN
+    if (!dir || !dir->entry) return 0;
+    switch (dir->entry->d_type)
+    {
+        case DT_REG: return 'f';
+        case DT_DIR: return 'd';
+        case DT_LNK: return 'l';
+        case DT_BLK: return 'b';
+        case DT_CHR: return 'c';
+        case DT_FIFO: return 'p';
+        case DT_SOCK: return 's';
+        default: return 0;
+    }
+#else
+    (void)dir;
+    return 0;
+#endif
+}
+
+// lstat `name` inside an open directory; `path` (the same entry as a
+// full path) is only read where there is no fstatat()
+#ifndef _WIN32
+    #define PLATFORM_STAT_AT 1
+#else
+    #define PLATFORM_STAT_AT 0
+#endif
+
+UDU_SI bool platform_stat_at(platform_dir_t *dir,
+                             const char *name,
+                             const char *path,
+                             platform_stat_t *st)
+{
+#if PLATFORM_STAT_AT
+    (void)path;
+    struct stat sb;
+    if (fstatat(dirfd(dir->dir), name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+        return false;
+    platform_fill_stat(st, &sb);
+    return true;
+#else
+    (void)dir;
+    (void)name;
+    struct stat sb;
+    if (lstat(path, &sb) != 0) return false;
+    platform_fill_stat(st, &sb);
+    return true;
+#endif
+}
+
 UDU_SI void platform_closedir(platform_dir_t *dir)
 {
     if (dir)
@@ -100,6 +210,105 @@ UDU_SI void platform_closedir(platform_dir_t *dir)
     }
 }
 
+// zeroed memory on an `align` boundary (a power of two); release it with
+// platform_aligned_free()
+UDU_SI void *platform_aligned_calloc(size_t align, size_t size)
+{
+    size = (size + align - 1) & ~(align - 1); // aligned_alloc wants a multiple
+#ifdef _WIN32
+    void *p = _aligned_malloc(size, align);
+#else
+    void *p = aligned_alloc(align, size);
+#endif
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+UDU_SI void platform_aligned_free(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// map a whole file read-only; falls back to reading it where mmap(2) is
+// not available. Returns NULL for a missing, empty or unreadable file
+UDU_SI const unsigned char *platform_map_file(const char *path, size_t *len)
+{
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat sb;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0)
+        p = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+
+    *len = (size_t)sb.st_size;
+    return p;
+#else
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    unsigned char *p = NULL;
+    if (fseek(fp, 0, SEEK_END) == 0)
+    {
+        long size = ftell(fp);
+        if (size > 0 && fseek(fp, 0, SEEK_SET) == 0 &&
+            (p = malloc((size_t)size)) &&
+            fread(p, 1, (size_t)size, fp) != (size_t)size)
+        {
+            free(p);
+            p = NULL;
+        }
+        if (p) *len = (size_t)size;
+    }
+    fclose(fp);
+    return p;
+#endif
+}
+
+UDU_SI void platform_unmap_file(const unsigned char *p, size_t len)
+{
+    if (!p) return;
+#ifndef _WIN32
+    munmap((void *)p, len);
+#else
+    (void)len;
+    free((void *)p);
+#endif
+}
+
+// user or group name for reports; falls back to the numeric id
+UDU_SI const char *platform_owner_name(uint32_t id,
+                                       bool group,
+                                       char *buf,
+                                       size_t buflen)
+{
+    const char *name = NULL;
+#ifndef _WIN32
+    if (group)
+    {
+        struct group *gr = getgrgid((gid_t)id);
+        if (gr) name = gr->gr_name;
+    }
+    else
+    {
+        struct passwd *pw = getpwuid((uid_t)id);
+        if (pw) name = pw->pw_name;
+    }
+#endif
+    if (name)
+        snprintf(buf, buflen, "%s", name);
+    else
+        snprintf(buf, buflen, "%u", id);
+    return buf;
+}
+
 UDU_SI bool is_symlink(const char *path)
 {
     struct stat st;
@@ -0,0 +1,299 @@
+/*
+ * Snapshot file layout (integers little-endian):
+ *
+ *   "UDUSNAP1"          magic
+ *   u32 flags           bit 0: sizes are apparent (-a)
+ *   u32 reserved
+ *   u64 count           number of records that follow
+ *
+ * Records are sorted by strcmp() of their path and each path is
+ * delta-encoded against the previous one, so sibling directories cost
+ * a few bytes each:
+ *
+ *   varint shared       bytes in common with the previous path
+ *   varint suffix_len
+ *   suffix bytes
+ *   varint size         subtree total
+ *   varint nfiles
+ *
+ * The reader maps the file and decodes it front to back, which lets
+ * --diff merge it against a new scan without loading the old tree.
+ */
+
+#include "snapshot.h"
+#include "const.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAP_MAGIC "UDUSNAP1"
+#define SNAP_HEADER 24
+#define SNAP_APPARENT 1u
+
+typedef struct
+{
+    const unsigned char *p;
+    const unsigned char *end;
+} cursor_t;
+
+typedef struct
+{
+    snap_change_t *v;
+    size_t n;
+    size_t cap;
+} changes_t;
+
+UDU_SI size_t put_varint(unsigned char *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
+}
+
+UDU_SI void put_le(unsigned char *out, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) out[i] = (unsigned char)(v >> (8 * i));
+}
+
+UDU_SI uint64_t get_le(const unsigned char *in, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)in[i] << (8 * i);
+    return v;
+}
+
+UDU_SI bool get_varint(cursor_t *c, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; c->p < c->end && shift < 64; shift += 7)
+    {
+        unsigned char b = *c->p++;
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+UDU_SI size_t common_prefix(const char *a, const char *b)
+{
+    size_t n = 0;
+    while (a[n] && a[n] == b[n]) n++;
+    return n;
+}
+
+bool snapshot_save(const char *file, const udu_result_t *res, bool apparent)
+{
+    size_t len = strlen(file);
+    char *tmp = malloc(len + 5);
+    if (!tmp) return false;
+    memcpy(tmp, file, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "Error: cannot write '%s'\n", tmp);
+        free(tmp);
+        return false;
+    }
+
+    unsigned char head[SNAP_HEADER];
+    memcpy(head, SNAP_MAGIC, 8);
+    put_le(head + 8, apparent ? SNAP_APPARENT : 0, 4);
+    put_le(head + 12, 0, 4);
+    put_le(head + 16, res->ndir_list, 8);
+    fwrite(head, 1, sizeof(head), fp);
+
+    const char *prev = "";
+    for (size_t i = 0; i < res->ndir_list; i++)
+    {
+        const udu_dir_t *d = &res->dir_list[i];
+        size_t shared = common_prefix(prev, d->path);
+        size_t suffix = strlen(d->path + shared);
+
+        unsigned char rec[40];
+        size_t n = put_varint(rec, shared);
+        n += put_varint(rec + n, suffix);
+        fwrite(rec, 1, n, fp);
+        fwrite(d->path + shared, 1, suffix, fp);
+
+        n = put_varint(rec, d->agg.size);
+        n += put_varint(rec + n, d->agg.nfiles);
+        fwrite(rec, 1, n, fp);
+        prev = d->path;
+    }
+
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0) ok = false;
+    if (ok && rename(tmp, file) != 0) ok = false;
+    if (!ok)
+    {
+        fprintf(stderr, "Error: cannot write '%s'\n", file);
+        remove(tmp);
+    }
+    free(tmp);
+    return ok;
+}
+
+static bool change_push(changes_t *c,
+                        const char *path,
+                        uint64_t old_size,
+                        uint64_t new_size,
+                        uint64_t threshold)
+{
+    uint64_t delta =
+      new_size > old_size ? new_size - old_size : old_size - new_size;
+    if (delta == 0 || delta < threshold) return true;
+
+    if (c->n >= c->cap)
+    {
+        size_t cap = c->cap ? c->cap * 2 : 64;
+        snap_change_t *v = realloc(c->v, cap * sizeof(snap_change_t));
+        if (!v) return false;
+        c->v = v;
+        c->cap = cap;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return false;
+    c->v[c->n++] = (snap_change_t){ .path = copy,
+                                    .old_size = old_size,
+                                    .new_size = new_size };
+    return true;
+}
+
+// largest growth first, largest shrink last
+static int change_cmp(const void *a, const void *b)
+{
+    const snap_change_t *ca = a;
+    const snap_change_t *cb = b;
+    int64_t da = (int64_t)(ca->new_size - ca->old_size);
+    int64_t db = (int64_t)(cb->new_size - cb->old_size);
+    if (da != db) return da < db ? 1 : -1;
+    return strcmp(ca->path, cb->path);
+}
+
+bool snapshot_diff(const char *file,
+                   const udu_result_t *res,
+                   bool apparent,
+                   uint64_t threshold,
+                   snap_change_t **changes,
+                   size_t *count)
+{
+    *changes = NULL;
+    *count = 0;
+
+    size_t len = 0;
+    const unsigned char *map = platform_map_file(file, &len);
+    if (!map || len < SNAP_HEADER || memcmp(map, SNAP_MAGIC, 8) != 0)
+    {
+        fprintf(stderr, "Error: '%s' is not a udu snapshot\n", file);
+        platform_unmap_file(map, len);
+        return false;
+    }
+
+    if (!(get_le(map + 8, 4) & SNAP_APPARENT) != !apparent)
+    {
+        fprintf(stderr,
+                "Error: '%s' was saved %s -a\n",
+                file,
+                apparent ? "without" : "with");
+        platform_unmap_file(map, len);
+        return false;
+    }
+
+    uint64_t nrec = get_le(map + 16, 8);
+    cursor_t cur = { .p = map + SNAP_HEADER, .end = map + len };
+    changes_t out = { 0 };
+    char *path = NULL;
+    size_t pathcap = 0;
+    size_t j = 0;
+    bool ok = true;
+
+    // both sides are sorted by path: a single linear merge pairs them up
+    for (uint64_t r = 0; ok && r < nrec; r++)
+    {
+        uint64_t shared, suffix, size, nfiles;
+        if (!get_varint(&cur, &shared) || !get_varint(&cur, &suffix) ||
+            suffix > (uint64_t)(cur.end - cur.p) ||
+            (r > 0 ? shared > strlen(path) : shared != 0))
+        {
+            ok = false;
+            break;
+        }
+
+        if (shared + suffix + 1 > pathcap)
+        {
+            size_t cap = (shared + suffix + 256) & ~(size_t)63;
+            char *p = realloc(path, cap);
+            if (!p)
+            {
+                ok = false;
+                break;
+            }
+            path = p;
+            pathcap = cap;
+        }
+        memcpy(path + shared, cur.p, suffix);
+        path[shared + suffix] = '\0';
+        cur.p += suffix;
+
+        if (!get_varint(&cur, &size) || !get_varint(&cur, &nfiles))
+        {
+            ok = false;
+            break;
+        }
+
+        int cmp = 1;
+        while (ok && j < res->ndir_list &&
+               (cmp = strcmp(res->dir_list[j].path, path)) < 0)
+        {
+            const udu_dir_t *d = &res->dir_list[j++];
+            ok = change_push(&out, d->path, 0, d->agg.size, threshold);
+        }
+
+        if (ok && j < res->ndir_list && cmp == 0)
+        {
+            ok = change_push(
+              &out, path, size, res->dir_list[j].agg.size, threshold);
+            j++;
+        }
+        else if (ok)
+        {
+            ok = change_push(&out, path, size, 0, threshold);
+        }
+    }
+
+    for (; ok && j < res->ndir_list; j++)
+    {
+        const udu_dir_t *d = &res->dir_list[j];
+        ok = change_push(&out, d->path, 0, d->agg.size, threshold);
+    }
+
+    free(path);
+    platform_unmap_file(map, len);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Error: '%s' is truncated or corrupt\n", file);
+        snapshot_changes_free(out.v, out.n);
+        return false;
+    }
+
+    if (out.n > 1) qsort(out.v, out.n, sizeof(snap_change_t), change_cmp);
+    *changes = out.v;
+    *count = out.n;
+    return true;
+}
+
+void snapshot_changes_free(snap_change_t *changes, size_t count)
+{
+    for (size_t i = 0; i < count; i++) free(changes[i].path);
+    free(changes);
+}
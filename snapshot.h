@@ -0,0 +1,25 @@
+#ifndef UDU_SNAPSHOT_H
+#define UDU_SNAPSHOT_H
+
+#include "walk.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    char *path;
+    uint64_t old_size;
+    uint64_t new_size;
+} snap_change_t;
+
+bool snapshot_save(const char *file, const udu_result_t *res, bool apparent);
+bool snapshot_diff(const char *file,
+                   const udu_result_t *res,
+                   bool apparent,
+                   uint64_t threshold,
+                   snap_change_t **changes,
+                   size_t *count);
+void snapshot_changes_free(snap_change_t *changes, size_t count);
+
+#endif
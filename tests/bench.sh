@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# Synthetic workload for `make pgo`: a handful of mktree.sh trees scanned
+# with the option sets that select the different walker variants.
+#
+# usage: bench.sh train UDU        run the workload once (profile training)
+#        bench.sh compare BASE UDU  time both, report UDU's speedup
+#
+# RUNS (default 7) sets the timed runs per binary and option set; the
+# median is reported. Times are wall clock with a warm cache.
+
+set -u
+set -f # the -X patterns below are for udu, not the shell
+
+mode=$1
+shift
+
+root=$(mktemp -d "${TMPDIR:-/tmp}/udu-bench.XXXXXX") || exit 1
+trap 'rm -rf "$root"' EXIT INT TERM
+
+tree=$root/tree
+for seed in 1 2 3 4 5 6; do
+    mkdir -p "$tree/$seed"
+    "$(dirname "$0")/mktree.sh" "$seed" "$tree/$seed"
+done
+
+# one line per walker variant, plus the modes that bypass it
+options='
+-q
+-a
+-q -X *.log -X d1?
+-a --top-files=10 --age-buckets=7,30
+-d 2
+-a --inode-order
+-t
+'
+
+# wall time of `$@` in milliseconds
+ms() {
+    start=$(date +%s%N)
+    "$@" >/dev/null 2>&1
+    end=$(date +%s%N)
+    echo $(((end - start) / 1000000))
+}
+
+median() {
+    sort -n | awk '{ v[NR] = $1 } END { print v[int((NR + 1) / 2)] }'
+}
+
+case $mode in
+train)
+    udu=$1
+    echo "$options" | while read -r opts; do
+        [ -n "$opts" ] || continue
+        for threads in 1 4; do
+            OMP_NUM_THREADS=$threads "$udu" $opts "$tree" >/dev/null 2>&1
+        done
+    done
+    ;;
+compare)
+    base=$1
+    udu=$2
+    runs=${RUNS:-7}
+    printf '%-40s %10s %10s %8s\n' options "base ms" "new ms" speedup
+    echo "$options" | while read -r opts; do
+        [ -n "$opts" ] || continue
+        "$base" $opts "$tree" >/dev/null 2>&1 # warm the cache
+        i=0
+        : >"$root/base" && : >"$root/new"
+        while [ $i -lt "$runs" ]; do
+            ms "$base" $opts "$tree" >>"$root/base"
+            ms "$udu" $opts "$tree" >>"$root/new"
+            i=$((i + 1))
+        done
+        b=$(median <"$root/base")
+        n=$(median <"$root/new")
+        printf '%-40s %10s %10s' "$opts" "$b" "$n"
+        awk -v b="$b" -v n="$n" 'BEGIN {
+            if (n > 0) printf " %7.1f%%\n", (b / n - 1) * 100
+            else print "       -"
+        }'
+    done
+    ;;
+*)
+    echo "usage: bench.sh train UDU | bench.sh compare BASE UDU" >&2
+    exit 2
+    ;;
+esac
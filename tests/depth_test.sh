@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Check the order of `udu -d` listings: every directory after all of its
+# descendants, each subtree contiguous, siblings whose names share a
+# prefix ("a", "a-b", "a.c") kept apart. Then check that a tree deeper
+# than udu descends gets the same directory count with and without -t.
+#
+# usage: depth_test.sh UDU
+
+set -u
+
+udu=$1
+
+root=$(mktemp -d "${TMPDIR:-/tmp}/udu-depth.XXXXXX") || exit 1
+trap 'rm -rf "$root"' EXIT INT TERM
+
+mkdir -p "$root/a/b" "$root/a-b" "$root/a.c/x" "$root/a/b/c"
+
+got=$("$udu" -a -d 2 "$root" | awk -v r="$root" '
+    index($0, r) { sub(".*" r, "."); print }' | tr '\n' ' ')
+want='./a/b ./a ./a-b ./a.c/x ./a.c . '
+
+if [ "$got" != "$want" ]; then
+    echo "FAIL: depth_test: got '$got', expected '$want'"
+    exit 1
+fi
+
+deep=$root/deep
+p=$deep
+for i in $(seq 70); do p=$p/d; done
+mkdir -p "$p"
+
+dirs() {
+    "$udu" "$@" "$deep" 2>/dev/null |
+        sed -n 's/^Total: .* files, \([0-9]*\) dir.*/\1/p'
+}
+walked=$(dirs)
+tree=$(dirs -t)
+if [ -z "$walked" ] || [ "$walked" != "$tree" ]; then
+    echo "FAIL: depth_test: deep tree: $walked directories, $tree with -t"
+    exit 1
+fi
+echo "depth_test: ok"
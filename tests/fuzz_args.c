@@ -0,0 +1,30 @@
+/*
+ * Input: NUL-separated arguments. args_parse() must accept or reject
+ * them without crashing; run under ASan/UBSan.
+ */
+
+#include "../args.h"
+#include "fuzz_main.h"
+
+#define MAX_ARGS 256
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    char *buf = malloc(size + 1);
+    if (!buf) return 0;
+    memcpy(buf, data, size);
+    buf[size] = '\0';
+
+    char *argv[MAX_ARGS + 1] = { "udu" };
+    int argc = 1;
+    for (char *p = buf; p <= buf + size && argc < MAX_ARGS; p += strlen(p) + 1)
+        argv[argc++] = p;
+
+    args_t args;
+    args_init(&args);
+    args_parse(&args, argc, argv);
+    args_free(&args);
+
+    free(buf);
+    return 0;
+}
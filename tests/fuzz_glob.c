@@ -0,0 +1,51 @@
+/*
+ * Input: pattern NUL text. glob_match() must agree with fnmatch(3) and
+ * finish in time; run libFuzzer with -timeout to catch slow patterns.
+ */
+
+#include "../util.h"
+#include "fuzz_main.h"
+#include <fnmatch.h>
+
+// fnmatch() itself backtracks on every '*', so compare only where it is
+// guaranteed to be quick; glob_match() still runs on everything
+#define DIFF_MAX_LEN 64
+#define DIFF_MAX_STARS 4
+
+// see glibc_quirk() in test_glob.c; "[." "[:" "[=" are not supported
+static bool comparable(const char *pat)
+{
+    size_t len = strlen(pat);
+    int stars = 0;
+    for (const char *p = pat; *p; p++)
+    {
+        if (*p == '*') stars++;
+        if (*p == '[' && p[1] && strchr(".:=", p[1])) return false;
+        if (*p == '[' && !class_end(UC(p + 1)) && pat[len - 1] == '-')
+            return false;
+    }
+    return len <= DIFF_MAX_LEN && stars <= DIFF_MAX_STARS;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    char *buf = malloc(size + 2);
+    if (!buf) return 0;
+    memcpy(buf, data, size);
+    buf[size] = buf[size + 1] = '\0';
+
+    const char *pat = buf;
+    const char *txt = buf + strlen(buf) + 1;
+    if (txt > buf + size) txt = buf + size + 1;
+
+    bool got = glob_match(pat, txt);
+    if (comparable(pat) && strlen(txt) <= DIFF_MAX_LEN &&
+        got != (fnmatch(pat, txt, FNM_NOESCAPE) == 0))
+    {
+        fprintf(stderr, "glob_match(\"%s\", \"%s\") = %d\n", pat, txt, got);
+        abort();
+    }
+
+    free(buf);
+    return 0;
+}
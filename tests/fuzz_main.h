@@ -0,0 +1,48 @@
+#ifndef UDU_FUZZ_MAIN_H
+#define UDU_FUZZ_MAIN_H
+
+/*
+ * Built with -fsanitize=fuzzer, libFuzzer supplies main(). Otherwise
+ * (afl-clang-fast, or a plain compiler for `make check`) each file named
+ * on the command line is run through the harness once, or stdin when
+ * there are none, which is what AFL expects.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#ifndef UDU_LIBFUZZER
+
+    #define FUZZ_MAX (1 << 20)
+
+static int fuzz_file(FILE *fp)
+{
+    static uint8_t buf[FUZZ_MAX];
+    size_t n = fread(buf, 1, sizeof(buf), fp);
+    return LLVMFuzzerTestOneInput(buf, n);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) return fuzz_file(stdin);
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *fp = fopen(argv[i], "rb");
+        if (!fp)
+        {
+            fprintf(stderr, "Error: cannot open '%s'\n", argv[i]);
+            return 1;
+        }
+        fuzz_file(fp);
+        fclose(fp);
+    }
+    return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Build a deterministic tree for SEED under DIR: nested directories,
+# files of random sizes, sparse files, odd names, and one directory large
+# enough for the dense-directory path in walk.c.
+#
+# usage: mktree.sh SEED DIR
+
+set -u
+
+awk -v seed="$1" -v root="$2" 'BEGIN {
+    srand(seed)
+    ndirs = 1; dirs[0] = root
+    for (i = 0; i < 60; i++) {
+        d = dirs[int(rand() * ndirs)] "/d" i
+        if (i % 7 == 0) d = d " sp"
+        dirs[ndirs++] = d
+        print "mkdir -p \"" d "\""
+    }
+    for (i = 0; i < 400; i++) {
+        f = dirs[int(rand() * ndirs)] "/f" i
+        size = int(rand() * rand() * 300000)
+        if (i % 25 == 0)
+            print "truncate -s " size * 10 " \"" f "\""
+        else
+            print "head -c " size " /dev/zero > \"" f "\""
+    }
+    print "mkdir -p \"" root "/dense\""
+    print "cd \"" root "/dense\" && seq 1 " 4500 + int(rand() * 3000) \
+          " | xargs touch && cd / "
+}' | sh
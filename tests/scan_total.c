@@ -0,0 +1,29 @@
+/*
+ * `udu` with exact output: takes udu's options and prints the total as
+ * "<bytes> <files> <directories>" for tree_test.sh to compare.
+ */
+
+#include "../args.h"
+#include "../walk.h"
+
+int main(int argc, char **argv)
+{
+    args_t args;
+    args_init(&args);
+    if (!args_parse(&args, argc, argv))
+    {
+        args_free(&args);
+        return 2;
+    }
+
+    udu_result_t res = walk_paths(&args, NULL);
+    printf("%lu %lu %lu\n",
+           res.total.size,
+           res.total.nfiles,
+           res.total.ndirs);
+
+    int status = res.nfailed ? 1 : 0;
+    walk_result_free(&res);
+    args_free(&args);
+    return status;
+}
@@ -0,0 +1,238 @@
+/*
+ * libudu through udu.h only: totals of a small known tree, visitor
+ * batches, the setters, a handle run more than once, and a file given
+ * as the path.
+ */
+
+#include "../udu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int failures;
+
+#define EXPECT(cond)                                                           \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond);  \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+// root/{f1, big, sub/f2, sub/deep/f3, empty/}
+#define TREE_BYTES (100 + 5000 + 300 + 7)
+#define TREE_FILES 4
+#define TREE_DIRS 4 // the scanned directory counts as one
+
+static char root[64];
+
+typedef struct
+{
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t dirs;
+    uint64_t calls;
+    uint64_t max_batch;
+} seen_t;
+
+static void add(uint64_t *v, uint64_t n)
+{
+    __atomic_fetch_add(v, n, __ATOMIC_RELAXED);
+}
+
+static void note_batch(seen_t *s, size_t n)
+{
+    add(&s->calls, 1);
+    uint64_t max = __atomic_load_n(&s->max_batch, __ATOMIC_RELAXED);
+    while (n > max &&
+           !__atomic_compare_exchange_n(
+             &s->max_batch, &max, n, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void on_entry(const udu_entry_t *v, size_t n, void *user)
+{
+    seen_t *s = user;
+    note_batch(s, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        add(&s->entries, 1);
+        add(&s->bytes, v[i].apparent);
+    }
+}
+
+static void on_dir(const udu_dir_t *v, size_t n, void *user)
+{
+    seen_t *s = user;
+    note_batch(s, n);
+    for (size_t i = 0; i < n; i++) add(&s->dirs, v[i].path != NULL);
+}
+
+static bool write_file(const char *name, size_t size)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    for (size_t i = 0; i < size; i++) fputc('x', f);
+    return fclose(f) == 0;
+}
+
+static bool make_tree(void)
+{
+    char path[128];
+    snprintf(root, sizeof(root), "%s", "/tmp/udu-api.XXXXXX");
+    if (!mkdtemp(root)) return false;
+
+    static const char *dirs[] = { "sub", "sub/deep", "empty" };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, dirs[i]);
+        if (mkdir(path, 0755) != 0) return false;
+    }
+    return write_file("f1", 100) && write_file("big", 5000) &&
+           write_file("sub/f2", 300) && write_file("sub/deep/f3", 7);
+}
+
+static void remove_tree(void)
+{
+    static const char *names[] = { "sub/deep/f3", "sub/f2", "big", "f1",
+                                   "sub/deep",    "sub",    "empty" };
+    char path[128];
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, names[i]);
+        remove(path);
+    }
+    rmdir(root);
+}
+
+static void check_totals_and_visitor(udu_scan_t *scan)
+{
+    seen_t seen = { 0 };
+    udu_visitor_t vis = {
+        .on_entry = on_entry, .on_dir = on_dir, .user = &seen, .batch = 2
+    };
+    udu_scan_set_visitor(scan, &vis);
+    udu_scan_set_dir_list(scan, true);
+
+    // the second run must not add to the first
+    for (int run = 1; run <= 2; run++)
+    {
+        const udu_result_t *res = udu_scan_run(scan);
+        EXPECT(res->nroots == 1 && res->roots[0].ok);
+        EXPECT(res->total.size == TREE_BYTES);
+        EXPECT(res->total.nfiles == TREE_FILES);
+        EXPECT(res->total.ndirs == TREE_DIRS);
+        EXPECT(res->ndir_list == TREE_DIRS);
+        EXPECT(res->nfailed == 0);
+
+        EXPECT(seen.entries == (uint64_t)run * TREE_FILES);
+        EXPECT(seen.bytes == (uint64_t)run * TREE_BYTES);
+        EXPECT(seen.dirs == (uint64_t)run * TREE_DIRS);
+    }
+    EXPECT(seen.max_batch == 2);
+    EXPECT(seen.calls >= TREE_FILES + TREE_DIRS); // two runs, 2 per call
+
+    udu_scan_set_visitor(scan, NULL);
+    udu_scan_set_dir_list(scan, false);
+}
+
+static void check_setters(udu_scan_t *scan)
+{
+    int days[] = { 1, 30 };
+    EXPECT(udu_scan_set_ages(scan, days, 2, 'm'));
+    udu_scan_set_max_depth(scan, 0);
+    const udu_result_t *res = udu_scan_run(scan);
+    EXPECT(res->total.age_size[0] == TREE_BYTES); // all written just now
+    EXPECT(res->total.age_files[0] == TREE_FILES);
+    EXPECT(res->ndir_list == 1);
+    EXPECT(res->ndir_list && res->dir_list[0].agg.age_size[0] == TREE_BYTES);
+    EXPECT(udu_scan_set_ages(scan, NULL, 0, 'm'));
+    udu_scan_set_max_depth(scan, -1);
+
+    EXPECT(udu_scan_set_filter(scan, 200, UINT64_MAX, "f", 0));
+    res = udu_scan_run(scan);
+    EXPECT(res->total.size == 5000 + 300 && res->total.nfiles == 2);
+    EXPECT(udu_scan_set_filter(scan, 0, UINT64_MAX, NULL, 0));
+
+    udu_scan_set_max_depth(scan, 1);
+    res = udu_scan_run(scan);
+    EXPECT(res->ndir_list == 3); // root, sub and empty
+    for (size_t i = 0; i < res->ndir_list; i++)
+        EXPECT(res->dir_list[i].depth <= 1);
+    udu_scan_set_max_depth(scan, -1);
+
+    // rejected specs leave the scan as it was
+    int bad[] = { 30, 7 };
+    EXPECT(!udu_scan_set_ages(scan, bad, 2, 'm'));
+    EXPECT(!udu_scan_set_ages(scan, days, 2, 'x'));
+    EXPECT(!udu_scan_set_filter(scan, 2, 1, NULL, 0));
+    EXPECT(!udu_scan_set_filter(scan, 0, UINT64_MAX, "d", 0));
+    res = udu_scan_run(scan);
+    EXPECT(res->total.size == TREE_BYTES && res->total.age_size[0] == 0);
+}
+
+// a path that is itself a file goes through the same filters
+static void check_file_operand(void)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/big", root);
+
+    udu_scan_t *scan = udu_scan_new();
+    EXPECT(scan != NULL);
+    if (!scan) return;
+    EXPECT(udu_scan_add_path(scan, path));
+    udu_scan_set_apparent(scan, true);
+
+    const udu_result_t *res = udu_scan_run(scan);
+    EXPECT(res->total.size == 5000 && res->total.nfiles == 1);
+
+    EXPECT(udu_scan_set_filter(scan, 6000, UINT64_MAX, NULL, 0));
+    res = udu_scan_run(scan);
+    EXPECT(res->total.size == 0 && res->total.nfiles == 0);
+
+    EXPECT(udu_scan_set_filter(scan, 0, UINT64_MAX, "p", 0));
+    res = udu_scan_run(scan);
+    EXPECT(res->total.nfiles == 0);
+
+    EXPECT(udu_scan_set_filter(scan, 1000, 5000, "f", 0));
+    res = udu_scan_run(scan);
+    EXPECT(res->total.size == 5000 && res->total.nfiles == 1);
+    udu_scan_free(scan);
+}
+
+int main(void)
+{
+    if (!make_tree())
+    {
+        perror("test_api: cannot build the test tree");
+        remove_tree();
+        return 1;
+    }
+
+    udu_scan_t *scan = udu_scan_new();
+    EXPECT(scan != NULL);
+    if (scan)
+    {
+        EXPECT(udu_scan_add_path(scan, root));
+        udu_scan_set_apparent(scan, true);
+        check_totals_and_visitor(scan);
+        check_setters(scan);
+        udu_scan_free(scan);
+    }
+    check_file_operand();
+    remove_tree();
+
+    if (failures)
+    {
+        fprintf(stderr, "test_api: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_api: ok\n");
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * args_parse(): accepted and rejected command lines, array growth past
+ * INIT_CAPACITY, and random argument vectors that must never crash.
+ */
+
+#include "../args.h"
+
+#define ROUNDS 20000
+
+static int failures;
+
+#define EXPECT(cond)                                                           \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond);  \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+// parse a NULL-terminated list of arguments (argv[0] is supplied)
+static bool parse(args_t *args, const char **list)
+{
+    char *argv[64] = { "udu" };
+    int argc = 1;
+    while (*list && argc < 63) argv[argc++] = (char *)*list++;
+
+    args_init(args);
+    return args_parse(args, argc, argv);
+}
+
+static bool accepts(const char **list)
+{
+    args_t args;
+    bool ok = parse(&args, list);
+    args_free(&args);
+    return ok;
+}
+
+// args_parse() reports every rejection on stderr
+static FILE *saved_stderr;
+
+static void mute(void)
+{
+    FILE *null = fopen("/dev/null", "w");
+    if (!null) return;
+    saved_stderr = stderr;
+    stderr = null;
+}
+
+static void unmute(void)
+{
+    if (!saved_stderr) return;
+    fclose(stderr);
+    stderr = saved_stderr;
+    saved_stderr = NULL;
+}
+
+static void check_valid(void)
+{
+    args_t args;
+
+    EXPECT(parse(&args, (const char *[]){ NULL }));
+    EXPECT(args.path_count == 1 && strcmp(args.paths[0], ".") == 0);
+    EXPECT(args.quiet && args.age_time == 'm' && args.max_depth == -1);
+    args_free(&args);
+
+    EXPECT(parse(&args,
+                 (const char *[]){ "-avX", "*.o", "/a", "-d1", "--top-files=3",
+                                   "--age-buckets=7,30", "--time=atime",
+                                   "--min-size=1K", "--max-size=2M",
+                                   "--type=f,p", "-X", "tmp", "/b", NULL }));
+    EXPECT(args.apparent_size && args.verbose && !args.quiet);
+    EXPECT(args.exclude_count == 2 && strcmp(args.excludes[1], "tmp") == 0);
+    EXPECT(args.path_count == 2 && strcmp(args.paths[1], "/b") == 0);
+    EXPECT(args.max_depth == 1 && args.top_files == 3);
+    EXPECT(args.age_count == 2 && args.age_days[1] == 30);
+    EXPECT(args.age_time == 'a');
+    EXPECT(args.min_size == 1024 && args.max_size == 2 * 1024 * 1024);
+    EXPECT(args.types && strcmp(args.types, "f,p") == 0);
+    args_free(&args);
+
+    EXPECT(parse(&args, (const char *[]){ "-", "--diff=s", NULL }));
+    EXPECT(args.path_count == 1 && strcmp(args.paths[0], "-") == 0);
+    EXPECT(args.dir_list);
+    args_free(&args);
+}
+
+static void check_invalid(void)
+{
+    static const char *bad[][3] = {
+        { "-X" },
+        { "-d" },
+        { "-d", "x" },
+        { "-k" },
+        { "--nope" },
+        { "--top-files=-1" },
+        { "--top-files=" },
+        { "--age-buckets=30,7" },
+        { "--age-buckets=1," },
+        { "--time=btime" },
+        { "--min-size=1Q" },
+        { "--min-size=2M", "--max-size=1M" },
+        { "--type=" },
+        { "--type=d" },
+        { "--newer=/nonexistent/udu-test" },
+        { "-t", "-d", "1" },
+        { "-t", "--diff=x" },
+        { "--daemon", "--query=/" },
+    };
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        const char *list[4] = { bad[i][0], bad[i][1], bad[i][2], NULL };
+        mute();
+        bool ok = accepts(list);
+        unmute();
+        if (ok)
+        {
+            fprintf(stderr, "FAIL: accepted '%s'\n", bad[i][0]);
+            failures++;
+        }
+    }
+}
+
+// both arrays start at INIT_CAPACITY and double as they fill
+static void check_growth(void)
+{
+    enum
+    {
+        N = INIT_CAPACITY * 5 + 3
+    };
+    static char names[N][16];
+    char *argv[2 * N + 1] = { "udu" };
+    int argc = 1;
+
+    for (int i = 0; i < N; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "p%d", i);
+        argv[argc++] = "-X";
+        argv[argc++] = names[i];
+    }
+
+    args_t args;
+    args_init(&args);
+    EXPECT(args_parse(&args, argc, argv));
+    EXPECT(args.exclude_count == N);
+    EXPECT(strcmp(args.excludes[N - 1], names[N - 1]) == 0);
+    args_free(&args);
+
+    argc = 1;
+    for (int i = 0; i < N; i++) argv[argc++] = names[i];
+    args_init(&args);
+    EXPECT(args_parse(&args, argc, argv));
+    EXPECT(args.path_count == N);
+    EXPECT(strcmp(args.paths[N - 1], names[N - 1]) == 0);
+    args_free(&args);
+}
+
+// random mixes of real options, broken values and plain words; only
+// crashes and sanitizer reports count as failures here
+static void check_random(void)
+{
+    static const char *words[] = {
+        "-a", "-v", "-q", "-t", "-X", "-d", "-d3", "-avX", "-", "--",
+        "--sparse", "--min-sparse-ratio=2", "--min-sparse-ratio=0",
+        "--age-buckets", "--age-buckets=1,2,3,4,5,6,7,8", "--time=ctime",
+        "--by-user", "--top-dirs=5", "--save-snapshot=x", "--diff=",
+        "--diff-threshold=1G", "--max-depth=", "--min-size=", "--type=fbcps",
+        "--inode-order", "--socket=", "--help", "--version", "path", "",
+    };
+    const int nwords = (int)(sizeof(words) / sizeof(words[0]));
+
+    mute();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        const char *list[12];
+        int n = rand() % 11;
+        for (int i = 0; i < n; i++) list[i] = words[rand() % nwords];
+        list[n] = NULL;
+        accepts(list);
+    }
+    unmute();
+}
+
+int main(void)
+{
+    srand(0x5eed);
+    check_valid();
+    check_invalid();
+    check_growth();
+    check_random();
+
+    if (failures)
+    {
+        fprintf(stderr, "test_args: %d failures\n", failures);
+        return 1;
+    }
+    printf("test_args: ok\n");
+    return 0;
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Build random trees and check udu's apparent-size totals against
+# `du --apparent-size -sb`. udu leaves directory entries' own sizes out
+# of its totals, so those are subtracted from du's figure first.
+#
+# usage: tree_test.sh SCAN_TOTAL [SEED...]
+
+set -u
+
+scan=$1
+shift
+[ $# -gt 0 ] || set -- 1 2 3
+
+root=$(mktemp -d "${TMPDIR:-/tmp}/udu-tree.XXXXXX") || exit 1
+trap 'rm -rf "$root"' EXIT INT TERM
+
+if ! du --apparent-size -sb "$root" >/dev/null 2>&1 ||
+    ! find "$root" -maxdepth 0 -printf '' >/dev/null 2>&1; then
+    echo "tree_test: SKIP (needs GNU du and find)"
+    exit 0
+fi
+
+fail=0
+
+check() {
+    got=$("$scan" "$@" "$dir") || { echo "FAIL: scan of $dir exited $?"; fail=1; return; }
+    set -- $got
+    if [ "$1" != "$want_bytes" ] || [ "$2" != "$want_files" ] || [ "$3" != "$want_dirs" ]; then
+        echo "FAIL: seed $seed: udu $got, expected $want_bytes $want_files $want_dirs"
+        fail=1
+    fi
+}
+
+for seed in "$@"; do
+    dir="$root/$seed"
+    mkdir "$dir"
+    "$(dirname "$0")/mktree.sh" "$seed" "$dir"
+
+    du_bytes=$(du --apparent-size -sb "$dir" | cut -f1)
+    dir_bytes=$(find "$dir" -type d -printf '%s\n' | awk '{ s += $1 } END { print s }')
+    want_bytes=$((du_bytes - dir_bytes))
+    want_files=$(find "$dir" ! -type d | wc -l | tr -d ' ')
+    want_dirs=$(find "$dir" -type d | wc -l | tr -d ' ')
+
+    for threads in 1 4; do
+        OMP_NUM_THREADS=$threads check -a
+        OMP_NUM_THREADS=$threads check -a --inode-order
+    done
+    [ $fail -eq 0 ] && echo "tree_test: seed $seed ok ($want_files files, $want_bytes bytes)"
+done
+
+exit $fail
@@ -0,0 +1,147 @@
+#include "udu.h"
+#include "args.h"
+#include "walk.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct udu_scan_s
+{
+    args_t args; // the engine's options; strings are owned copies
+    int path_cap;
+    int exclude_cap;
+    udu_visitor_t vis;
+    bool have_vis;
+    udu_result_t res;
+};
+
+udu_scan_t *udu_scan_new(void)
+{
+    udu_scan_t *scan = calloc(1, sizeof(udu_scan_t));
+    if (!scan) return NULL;
+
+    args_init(&scan->args);
+    scan->args.quiet = true;
+    scan->args.age_time = 'm';
+    return scan;
+}
+
+void udu_scan_free(udu_scan_t *scan)
+{
+    if (!scan) return;
+
+    for (int i = 0; i < scan->args.path_count; i++) free(scan->args.paths[i]);
+    for (int i = 0; i < scan->args.exclude_count; i++)
+        free(scan->args.excludes[i]);
+    free(scan->args.types);
+    args_free(&scan->args);
+    walk_result_free(&scan->res);
+    free(scan);
+}
+
+static bool push_string(char ***array, int *cap, int *count, const char *s)
+{
+    if (!*array)
+    {
+        *cap = INIT_CAPACITY;
+        *array = malloc(*cap * sizeof(char *));
+        if (!*array) return false;
+    }
+    if (!ensure_capacity(array, cap, *count)) return false;
+
+    char *copy = strdup(s);
+    if (!copy) return false;
+    (*array)[(*count)++] = copy;
+    return true;
+}
+
+bool udu_scan_add_path(udu_scan_t *scan, const char *path)
+{
+    return path && push_string(&scan->args.paths,
+                               &scan->path_cap,
+                               &scan->args.path_count,
+                               path);
+}
+
+bool udu_scan_add_exclude(udu_scan_t *scan, const char *pattern)
+{
+    return pattern && push_string(&scan->args.excludes,
+                                  &scan->exclude_cap,
+                                  &scan->args.exclude_count,
+                                  pattern);
+}
+
+void udu_scan_set_apparent(udu_scan_t *scan, bool apparent)
+{
+    scan->args.apparent_size = apparent;
+}
+
+void udu_scan_set_top(udu_scan_t *scan, int files, int dirs)
+{
+    scan->args.top_files = files > 0 ? files : 0;
+    scan->args.top_dirs = dirs > 0 ? dirs : 0;
+}
+
+void udu_scan_set_owners(udu_scan_t *scan, bool users, bool groups)
+{
+    scan->args.by_user = users;
+    scan->args.by_group = groups;
+}
+
+void udu_scan_set_dir_list(udu_scan_t *scan, bool enable)
+{
+    scan->args.dir_list = enable;
+}
+
+void udu_scan_set_max_depth(udu_scan_t *scan, int depth)
+{
+    scan->args.max_depth = depth >= 0 ? depth : -1;
+}
+
+bool udu_scan_set_ages(udu_scan_t *scan, const int *days, int n, char time)
+{
+    if (n < 0 || n > AGE_BUCKETS_MAX - 1 || !time || !strchr("mac", time))
+        return false;
+    for (int i = 0; i < n; i++)
+        if (days[i] <= 0 || (i > 0 && days[i] <= days[i - 1])) return false;
+
+    if (n > 0) memcpy(scan->args.age_days, days, n * sizeof(int));
+    scan->args.age_count = n;
+    scan->args.age_time = time;
+    return true;
+}
+
+bool udu_scan_set_filter(udu_scan_t *scan,
+                         uint64_t min_size,
+                         uint64_t max_size,
+                         const char *types,
+                         int64_t newer_than)
+{
+    if (min_size > max_size) return false;
+    if (types && strspn(types, "fbcps") != strlen(types)) return false;
+
+    char *copy = NULL;
+    if (types && *types && !(copy = strdup(types))) return false;
+
+    free(scan->args.types);
+    scan->args.types = copy;
+    scan->args.min_size = min_size;
+    scan->args.max_size = max_size;
+    scan->args.newer = newer_than > 0;
+    scan->args.newer_than = newer_than;
+    return true;
+}
+
+void udu_scan_set_visitor(udu_scan_t *scan, const udu_visitor_t *visitor)
+{
+    scan->have_vis = visitor != NULL;
+    if (visitor) scan->vis = *visitor;
+}
+
+const udu_result_t *udu_scan_run(udu_scan_t *scan)
+{
+    walk_result_free(&scan->res);
+    if (scan->args.path_count == 0) return &scan->res;
+
+    scan->res = walk_paths(&scan->args, scan->have_vis ? &scan->vis : NULL);
+    return &scan->res;
+}
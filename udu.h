@@ -0,0 +1,174 @@
+/*
+ * libudu - the udu scanning engine as a library
+ *
+ * A udu_scan_t holds the paths and options of a scan. udu_scan_run()
+ * walks every path in parallel and returns the totals as plain structs
+ * owned by the handle. Visitor callbacks run on the scanning threads,
+ * concurrently, and receive entries in batches; the pointers in a batch
+ * are only valid for the duration of the call.
+ */
+
+#ifndef UDU_H
+#define UDU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define UDU_AGE_BUCKETS_MAX 8
+
+// libudu is built with -fvisibility=hidden: only these functions are
+// exported
+#if defined(__GNUC__) || defined(__clang__)
+    #define UDU_API __attribute__((visibility("default")))
+#else
+    #define UDU_API
+#endif
+
+typedef struct
+{
+    uint64_t size; // apparent or allocated, as selected by -a
+    uint64_t nfiles;
+    uint64_t ndirs;
+    uint64_t apparent;
+    uint64_t allocated;
+    uint64_t sparse; // bytes saved by holes: sum of (apparent - allocated)
+    uint64_t nsparse; // files whose allocation is below their length
+    uint64_t age_size[UDU_AGE_BUCKETS_MAX]; // --age-buckets, youngest first
+    uint64_t age_files[UDU_AGE_BUCKETS_MAX];
+} udu_agg_t;
+
+typedef struct
+{
+    const char *path;
+    udu_agg_t agg;
+    bool ok;
+} udu_root_t;
+
+typedef struct
+{
+    char *path;
+    uint64_t size;
+} udu_top_t;
+
+typedef struct
+{
+    uint32_t id; // uid or gid
+    uint64_t size;
+    uint64_t nfiles;
+} udu_owner_t;
+
+// per-directory subtree totals; also what the directory visitor receives
+typedef struct
+{
+    char *path;
+    udu_agg_t agg; // the whole subtree, ages and sparse figures included
+    int depth; // 0 for a scanned path, 1 for its subdirectories, ...
+} udu_dir_t;
+
+// entries that could not be read, per errno value; UDU_ERR_DEPTH marks
+// directories nested too deeply to descend into
+#define UDU_ERR_DEPTH (-1)
+
+typedef struct
+{
+    int code;
+    uint64_t count;
+} udu_error_t;
+
+typedef struct
+{
+    char *path;
+    int code;
+} udu_failure_t;
+
+typedef struct
+{
+    udu_agg_t total;
+    udu_root_t *roots; // one per path, in the order they were given
+    int nroots;
+    udu_top_t *top_files; // largest first, at most top_files
+    int ntop_files;
+    udu_top_t *top_dirs; // largest first, at most top_dirs
+    int ntop_dirs;
+    udu_owner_t *users; // by user, largest first
+    int nusers;
+    udu_owner_t *groups; // by group, largest first
+    int ngroups;
+    udu_dir_t *dir_list; // every scanned directory, sorted by strcmp(path)
+    size_t ndir_list;
+    uint64_t nfailed; // entries skipped because they could not be read
+    udu_error_t *errors; // by errno, most frequent first
+    int nerrors;
+    udu_failure_t *failures; // a sample of failed paths, sorted by path
+    int nfailures;
+} udu_result_t;
+
+// one file as seen by the entry visitor
+typedef struct
+{
+    const char *path;
+    uint64_t size; // apparent or allocated, as selected
+    uint64_t apparent;
+    uint64_t allocated;
+    int64_t mtime;
+    uint32_t uid;
+    uint32_t gid;
+} udu_entry_t;
+
+typedef void (*udu_entry_fn)(const udu_entry_t *batch, size_t n, void *user);
+typedef void (*udu_dir_fn)(const udu_dir_t *batch, size_t n, void *user);
+
+// on_entry gets every file, on_dir every directory once its subtree is
+// complete. Batches are per thread, so across threads a parent may be
+// delivered before its children. Either may be NULL. `batch` is the
+// number of items per call, 0 for the default
+typedef struct
+{
+    udu_entry_fn on_entry;
+    udu_dir_fn on_dir;
+    void *user;
+    size_t batch;
+} udu_visitor_t;
+
+typedef struct udu_scan_s udu_scan_t;
+
+UDU_API udu_scan_t *udu_scan_new(void);
+UDU_API void udu_scan_free(udu_scan_t *scan);
+
+UDU_API bool udu_scan_add_path(udu_scan_t *scan, const char *path);
+UDU_API bool udu_scan_add_exclude(udu_scan_t *scan, const char *pattern);
+UDU_API void udu_scan_set_apparent(udu_scan_t *scan, bool apparent);
+UDU_API void udu_scan_set_top(udu_scan_t *scan, int files, int dirs);
+UDU_API void udu_scan_set_owners(udu_scan_t *scan, bool users, bool groups);
+UDU_API void udu_scan_set_dir_list(udu_scan_t *scan, bool enable);
+
+// dir_list gets the directories at most `depth` levels below each path
+// (-1 for none, the default); udu_scan_set_dir_list() lists them all
+UDU_API void udu_scan_set_max_depth(udu_scan_t *scan, int depth);
+
+// fill age_size/age_files: `n` increasing limits in days (at most
+// UDU_AGE_BUCKETS_MAX - 1, 0 to turn it off), by 'm'time, 'a'time or
+// 'c'time, which also applies to the filter's `newer_than`. False, with
+// nothing changed, for an invalid spec
+UDU_API bool udu_scan_set_ages(udu_scan_t *scan,
+                               const int *days,
+                               int n,
+                               char time);
+
+// count only files of min_size..max_size bytes (UINT64_MAX: no upper
+// limit), of the types in `types` (letters from "fbcps", NULL for any)
+// and changed after `newer_than` (seconds since the epoch, 0 for any).
+// False, with nothing changed, for an invalid spec
+UDU_API bool udu_scan_set_filter(udu_scan_t *scan,
+                                 uint64_t min_size,
+                                 uint64_t max_size,
+                                 const char *types,
+                                 int64_t newer_than);
+UDU_API void udu_scan_set_visitor(udu_scan_t *scan,
+                                  const udu_visitor_t *visitor);
+
+// runs the scan; the result stays valid until the next run or free
+UDU_API const udu_result_t *udu_scan_run(udu_scan_t *scan);
+
+#endif
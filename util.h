@@ -8,73 +8,103 @@
 // *readablelity*
 #define UC(s) ((const unsigned char *)(s))
 
-UDU_SI bool match_class(const unsigned char **patp, unsigned char c)
+// end of the bracket expression opened just before `p`, or NULL when it
+// is never closed and the '[' is an ordinary character (as fnmatch(3)
+// treats it). A ']' first in the set is part of it
+UDU_SI const unsigned char *class_end(const unsigned char *p)
+{
+    if (*p == '!' || *p == '^') p++;
+    if (*p == ']') p++;
+    while (*p && *p != ']') p++;
+    return *p ? p : NULL;
+}
+
+// does `c` belong to the set between `p` (just past '[') and `end`; a
+// range whose ends are reversed matches nothing
+UDU_SI bool match_class(const unsigned char *p,
+                        const unsigned char *end,
+                        unsigned char c)
 {
-    const unsigned char *p = *patp;
     bool negate = (*p == '!' || *p == '^');
     if (negate) p++;
 
     bool matched = false;
-    unsigned char prev = 0;
-    bool have_prev = false;
-
-    while (*p && *p != ']')
+    while (p < end)
     {
-        if (*p == '-' && have_prev && p[1] && p[1] != ']')
+        if (p + 2 < end && p[1] == '-')
         {
-            if (prev <= c && c <= p[1]) matched = true;
-            p += 2;
-            have_prev = false;
+            if (p[0] <= c && c <= p[2]) matched = true;
+            p += 3;
         }
         else
         {
             if (*p == c) matched = true;
-            prev = *p++;
-            have_prev = true;
+            p++;
         }
     }
 
-    if (*p == ']') p++;
-    *patp = p;
     return negate ? !matched : matched;
 }
 
-static inline bool glob_match_impl(const unsigned char *pat, const unsigned char *txt)
+// match one pattern element against `c`; advances *patp past it on success
+UDU_SI bool match_one(const unsigned char **patp, unsigned char c)
 {
-    while (*pat)
+    const unsigned char *p = *patp;
+    const unsigned char *end;
+
+    if (*p == '?')
+    {
+        p++;
+    }
+    else if (*p == '[' && (end = class_end(p + 1)))
+    {
+        if (!match_class(p + 1, end, c)) return false;
+        p = end + 1;
+    }
+    else
+    {
+        if (!*p || *p != c) return false;
+        p++;
+    }
+
+    *patp = p;
+    return true;
+}
+
+// every element but '*' consumes exactly one character, so on a mismatch
+// only the most recent '*' needs to take one more character: O(len(pat) *
+// len(txt)) at worst, where recursing on each '*' was exponential
+UDU_SI bool glob_match_impl(const unsigned char *pat, const unsigned char *txt)
+{
+    const unsigned char *star = NULL;
+    const unsigned char *resume = NULL;
+
+    while (*txt)
     {
         if (*pat == '*')
         {
             while (*pat == '*') pat++;
             if (!*pat) return true;
-
-            for (const unsigned char *t = txt; *t; t++)
-            {
-                if (glob_match_impl(pat, t)) return true;
-            }
-            return false;
+            star = pat;
+            resume = txt;
         }
-        else if (*pat == '?')
+        else if (match_one(&pat, *txt))
         {
-            if (!*txt) return false;
-            pat++;
             txt++;
         }
-        else if (*pat == '[')
+        else if (star)
         {
-            if (!*txt) return false;
-            pat++;
-            if (!match_class(&pat, *txt)) return false;
-            txt++;
+            pat = star;
+            txt = ++resume;
         }
         else
         {
-            if (*pat != *txt) return false;
-            pat++;
-            txt++;
+            return false;
         }
     }
-    return *txt == '\0';
+
+    while (*pat == '*') pat++;
+    return *pat == '\0';
 }
 
 UDU_SI bool glob_match(const char *pattern, const char *text)
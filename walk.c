@@ -3,31 +3,115 @@
 #include "const.h"
 #include "platform.h"
 #include "util.h"
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef _OPENMP
     #include <omp.h>
 #endif
 
-#define MAX_DEPTH 64
 #define BRANCH "├── "
 #define LAST "└── "
 #define VERT "│   "
 #define SPACE "    "
 #define INIT_CAP 64
+#define PREFIX_MAX ((MAX_DEPTH + 2) * sizeof(VERT))
+#define DENSE_MIN 4096 // entries a directory walks inline before chunking
+#define DENSE_CHUNK 1024
+#define ERR_SAMPLES 10 // failed paths kept per thread and in the result
 
 typedef struct node_s
 {
     char *name;
-    uint64_t size;
+    uint64_t apparent;
+    uint64_t alloc;
+    int64_t time; // --time selected timestamp, for --age-buckets
     struct node_s **kids;
-    uint16_t nkids;
-    uint16_t cap;
+    uint32_t nkids;
+    uint32_t cap;
     bool dir;
 } node_t;
 
+// bounded min-heap of the k largest entries seen; v[0] is the smallest
+typedef struct
+{
+    udu_top_t *v;
+    int n;
+    int k;
+} heap_t;
+
+// small open-addressing table of per-owner totals; OTAB_EMPTY marks a
+// free slot ((uid_t)-1 is never a real owner)
+#define OTAB_EMPTY UINT32_MAX
+#define OTAB_INIT 64
+
+typedef struct
+{
+    udu_owner_t *v;
+    uint32_t cap; // power of two
+    uint32_t n;
+} otab_t;
+
+typedef struct
+{
+    udu_dir_t *v;
+    size_t n;
+    size_t cap;
+} dirlog_t;
+
+// pending visitor calls; paths are packed into `text` until the batch is
+// handed to the callback. Only one of `entries`/`dirs` is used
+typedef struct
+{
+    udu_entry_t *entries;
+    udu_dir_t *dirs;
+    size_t n;
+    char *text;
+    size_t used;
+    size_t cap;
+} batch_t;
+
+// unreadable entries seen by one thread: counts per errno plus the first
+// few paths; filled without locks and merged with the rest of tstate_t
+typedef struct
+{
+    udu_error_t *v;
+    int n;
+    int cap;
+    udu_failure_t sample[ERR_SAMPLES];
+    int nsample;
+} errlog_t;
+
+// per-thread state, indexed by omp_get_thread_num() and merged after the
+// parallel region; aligned so neighbouring threads don't share a line
+typedef struct
+{
+    _Alignas(64) heap_t files;
+    heap_t dirs;
+    otab_t users;
+    otab_t groups;
+    dirlog_t log;
+    batch_t ebatch;
+    batch_t dbatch;
+    errlog_t errs;
+} tstate_t;
+
+// --min-size, --max-size, --type and --newer, resolved once per scan; a
+// file must pass all of them to be counted anywhere
+typedef struct
+{
+    bool on;
+    uint64_t min_size;
+    uint64_t max_size;
+    unsigned types; // type_bit() mask, 0 for any
+    bool newer;
+    int64_t newer_than;
+} filter_t;
+
 typedef struct
 {
     char **excl;
@@ -35,22 +119,537 @@ typedef struct
     bool apparent;
     bool verbose;
     bool tree;
-    uint64_t size;
-    uint64_t nfiles;
-    uint64_t ndirs;
+    bool sparse;
+    double min_sparse_ratio;
+    bool by_user;
+    bool by_group;
+    filter_t filter;
+    bool collect_dirs;
+    int dir_depth; // deepest directory collect_dirs keeps
+    bool inode_order;
+    int variant; // walkers[] index: apparent * 4 + excludes * 2 + full
+    const udu_visitor_t *vis;
+    size_t batch;
+    tstate_t *ts;
+    int nages;
+    char age_time;
+    int64_t now;
+    int64_t age_limit[AGE_BUCKETS_MAX - 1]; // seconds
 } ctx_t;
 
-static UDU_THD char *buf = NULL;
-static UDU_THD size_t bufsz = 0;
+// pending subdirectory; the child task fills in agg, the parent sums it
+// after taskwait so no counter is ever shared between threads
+typedef struct job_s
+{
+    struct job_s *next;
+    udu_agg_t agg;
+    char path[];
+} job_t;
+
+// slice of a dense directory's names, each stored as its type letter
+// (or 0) followed by the NUL-terminated name; the task
+// that stats it fills in agg, summed by the directory after taskwait
+typedef struct chunk_s
+{
+    struct chunk_s *next;
+    udu_agg_t agg;
+    size_t n;
+    char *text;
+    size_t used;
+    size_t cap;
+} chunk_t;
+
+// per-directory path buffer; `len` is the prefix length incl. trailing '/'
+typedef struct
+{
+    char *p;
+    size_t len;
+    size_t cap;
+} pathbuf_t;
+
+// --inode-order: a directory's entries read up front and sorted by inode
+// number, so the stats that follow sweep the inode table in one direction
+typedef struct
+{
+    uint64_t ino;
+    size_t off; // name offset in `text`
+    char type; // platform_dir_type()
+} dent_t;
+
+typedef struct
+{
+    dent_t *v;
+    size_t n;
+    size_t cap;
+    size_t pos;
+    char *text;
+    size_t used;
+    size_t tcap;
+} dents_t;
+
+// previous run's per-root entry counts (--root-cache), sorted by path
+typedef struct
+{
+    char *path;
+    uint64_t weight;
+} hint_t;
+
+typedef struct
+{
+    hint_t *v;
+    size_t n;
+    size_t cap;
+} hints_t;
+
+UDU_SI bool pathbuf_init(pathbuf_t *pb, const char *dir)
+{
+    size_t len = strlen(dir);
+    pb->cap = (len + 256) & ~(size_t)63;
+    pb->p = malloc(pb->cap);
+    if (!pb->p) return false;
+
+    memcpy(pb->p, dir, len);
+    if (len == 0 || dir[len - 1] != '/') pb->p[len++] = '/';
+    pb->p[len] = '\0';
+    pb->len = len;
+    return true;
+}
 
-UDU_SI char *getbuf(size_t needed)
+// append `name` to the directory prefix; returns the full length or 0
+UDU_SI size_t pathbuf_set(pathbuf_t *pb, const char *name)
 {
-    if (needed > bufsz)
+    size_t name_len = strlen(name);
+    size_t full_len = pb->len + name_len;
+
+    if (full_len + 1 > pb->cap)
     {
-        bufsz = (needed + 4095) & ~4095;
-        buf = realloc(buf, bufsz);
+        size_t cap = (full_len + 256) & ~(size_t)63;
+        char *p = realloc(pb->p, cap);
+        if (!p) return 0;
+        pb->p = p;
+        pb->cap = cap;
     }
-    return buf;
+
+    memcpy(pb->p + pb->len, name, name_len + 1);
+    return full_len;
+}
+
+UDU_SI unsigned type_bit(char type)
+{
+    const char *p = type ? strchr(PLATFORM_TYPES, type) : NULL;
+    return p ? 1u << (p - PLATFORM_TYPES) : 0;
+}
+
+UDU_SI chunk_t *chunk_new(void)
+{
+    chunk_t *c = calloc(1, sizeof(chunk_t));
+    if (!c) return NULL;
+    c->cap = DENSE_CHUNK * 32;
+    c->text = malloc(c->cap);
+    if (!c->text)
+    {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+UDU_SI bool chunk_add(chunk_t *c, const char *name, char type)
+{
+    size_t len = strlen(name) + 1;
+    if (c->used + len + 1 > c->cap)
+    {
+        size_t cap = c->cap * 2 + len + 1;
+        char *text = realloc(c->text, cap);
+        if (!text) return false;
+        c->text = text;
+        c->cap = cap;
+    }
+    c->text[c->used++] = type;
+    memcpy(c->text + c->used, name, len);
+    c->used += len;
+    c->n++;
+    return true;
+}
+
+static int dent_cmp(const void *a, const void *b)
+{
+    uint64_t ia = ((const dent_t *)a)->ino;
+    uint64_t ib = ((const dent_t *)b)->ino;
+    return ia < ib ? -1 : ia > ib;
+}
+
+// read the rest of `dir` into `d`, sorted by inode; false leaves `d`
+// empty and the caller falls back to readdir order
+static bool dents_load(dents_t *d, platform_dir_t *dir)
+{
+    const char *name;
+    while ((name = platform_readdir(dir)))
+    {
+        size_t len = strlen(name) + 1;
+        if (d->n >= d->cap || d->used + len > d->tcap)
+        {
+            size_t cap = d->n >= d->cap ? (d->cap ? d->cap * 2 : 64) : d->cap;
+            size_t tcap = d->tcap ? d->tcap : 4096;
+            while (d->used + len > tcap) tcap *= 2;
+
+            dent_t *v = realloc(d->v, cap * sizeof(dent_t));
+            if (v) d->v = v;
+            char *text = v ? realloc(d->text, tcap) : NULL;
+            if (!text) return false;
+            d->text = text;
+            d->cap = cap;
+            d->tcap = tcap;
+        }
+        memcpy(d->text + d->used, name, len);
+        d->v[d->n++] = (dent_t){ .ino = platform_dir_ino(dir),
+                                 .off = d->used,
+                                 .type = platform_dir_type(dir) };
+        d->used += len;
+    }
+
+    if (d->n > 1) qsort(d->v, d->n, sizeof(dent_t), dent_cmp);
+    return true;
+}
+
+UDU_SI const char *dents_next(dents_t *d, char *type)
+{
+    if (d->pos >= d->n) return NULL;
+    *type = d->v[d->pos].type;
+    return d->text + d->v[d->pos++].off;
+}
+
+UDU_SI void agg_add(udu_agg_t *dst, const udu_agg_t *src)
+{
+    dst->size += src->size;
+    dst->nfiles += src->nfiles;
+    dst->ndirs += src->ndirs;
+    dst->apparent += src->apparent;
+    dst->allocated += src->allocated;
+    dst->sparse += src->sparse;
+    dst->nsparse += src->nsparse;
+    for (int i = 0; i < AGE_BUCKETS_MAX; i++)
+    {
+        dst->age_size[i] += src->age_size[i];
+        dst->age_files[i] += src->age_files[i];
+    }
+}
+
+UDU_SI void agg_file(udu_agg_t *agg,
+                     uint64_t size,
+                     uint64_t apparent,
+                     uint64_t allocated)
+{
+    agg->size += size;
+    agg->nfiles++;
+    agg->apparent += apparent;
+    agg->allocated += allocated;
+    if (apparent > allocated)
+    {
+        agg->sparse += apparent - allocated;
+        agg->nsparse++;
+    }
+}
+
+UDU_SI int thread_id(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+UDU_SI void heap_swap(udu_top_t *a, udu_top_t *b)
+{
+    udu_top_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+static void heap_insert(heap_t *h, const char *path, uint64_t size)
+{
+    size_t len = strlen(path);
+
+    if (!h->v)
+    {
+        h->v = malloc(h->k * sizeof(udu_top_t));
+        if (!h->v) return;
+    }
+
+    if (h->n < h->k)
+    {
+        char *copy = malloc(len + 1);
+        if (!copy) return;
+        memcpy(copy, path, len + 1);
+
+        int i = h->n++;
+        h->v[i] = (udu_top_t){ .path = copy, .size = size };
+        while (i > 0 && h->v[(i - 1) / 2].size > h->v[i].size)
+        {
+            heap_swap(&h->v[(i - 1) / 2], &h->v[i]);
+            i = (i - 1) / 2;
+        }
+        return;
+    }
+
+    // evict the smallest, reusing its string allocation
+    char *copy = realloc(h->v[0].path, len + 1);
+    if (!copy) return;
+    memcpy(copy, path, len + 1);
+    h->v[0] = (udu_top_t){ .path = copy, .size = size };
+
+    for (int i = 0;;)
+    {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < h->n && h->v[l].size < h->v[m].size) m = l;
+        if (r < h->n && h->v[r].size < h->v[m].size) m = r;
+        if (m == i) break;
+        heap_swap(&h->v[i], &h->v[m]);
+        i = m;
+    }
+}
+
+// the common case is one compare against the current minimum; the path
+// is only copied when the entry actually makes it into the heap
+UDU_SI void heap_offer(heap_t *h, const char *path, uint64_t size)
+{
+    if (h->k == 0 || (h->n == h->k && size <= h->v[0].size)) return;
+    heap_insert(h, path, size);
+}
+
+UDU_SI int64_t stat_time(const platform_stat_t *st, const ctx_t *ctx)
+{
+    switch (ctx->age_time)
+    {
+        case 'a':
+            return st->atime;
+        case 'c':
+            return st->ctime;
+        default:
+            return st->mtime;
+    }
+}
+
+UDU_SI bool filter_match(const filter_t *f,
+                         const platform_stat_t *st,
+                         uint64_t size,
+                         const ctx_t *ctx)
+{
+    return size >= f->min_size && size <= f->max_size &&
+           (!f->types || (f->types & type_bit(st->type))) &&
+           (!f->newer || stat_time(st, ctx) > f->newer_than);
+}
+
+// timestamps in the future land in the youngest bucket
+UDU_SI void agg_age(udu_agg_t *agg,
+                    int64_t time,
+                    uint64_t size,
+                    const ctx_t *ctx)
+{
+    int64_t age = ctx->now - time;
+    int i = 0;
+    while (i < ctx->nages && age >= ctx->age_limit[i]) i++;
+    agg->age_size[i] += size;
+    agg->age_files[i]++;
+}
+
+UDU_SI uint32_t otab_hash(uint32_t id)
+{
+    id ^= id >> 16;
+    id *= 0x45d9f3bu;
+    id ^= id >> 16;
+    return id;
+}
+
+static udu_owner_t *otab_slot(udu_owner_t *v, uint32_t cap, uint32_t id)
+{
+    uint32_t i = otab_hash(id) & (cap - 1);
+    while (v[i].id != id && v[i].id != OTAB_EMPTY) i = (i + 1) & (cap - 1);
+    return &v[i];
+}
+
+static bool otab_grow(otab_t *t)
+{
+    uint32_t cap = t->cap ? t->cap * 2 : OTAB_INIT;
+    udu_owner_t *v = malloc(cap * sizeof(udu_owner_t));
+    if (!v) return false;
+    for (uint32_t i = 0; i < cap; i++) v[i].id = OTAB_EMPTY;
+
+    for (uint32_t i = 0; i < t->cap; i++)
+        if (t->v[i].id != OTAB_EMPTY) *otab_slot(v, cap, t->v[i].id) = t->v[i];
+
+    free(t->v);
+    t->v = v;
+    t->cap = cap;
+    return true;
+}
+
+UDU_SI void otab_add(otab_t *t, uint32_t id, uint64_t size, uint64_t nfiles)
+{
+    // keep the load factor under 3/4
+    if ((t->n + 1) * 4 > t->cap * 3 && !otab_grow(t)) return;
+
+    udu_owner_t *slot = otab_slot(t->v, t->cap, id);
+    if (slot->id == OTAB_EMPTY)
+    {
+        *slot = (udu_owner_t){ .id = id };
+        t->n++;
+    }
+    slot->size += size;
+    slot->nfiles += nfiles;
+}
+
+static void dirlog_push(dirlog_t *log,
+                        const char *path,
+                        const udu_agg_t *agg,
+                        int depth)
+{
+    if (log->n >= log->cap)
+    {
+        size_t cap = log->cap ? log->cap * 2 : INIT_CAP;
+        udu_dir_t *v = realloc(log->v, cap * sizeof(udu_dir_t));
+        if (!v) return;
+        log->v = v;
+        log->cap = cap;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return;
+    log->v[log->n++] =
+      (udu_dir_t){ .path = copy, .agg = *agg, .depth = depth };
+}
+
+static void batch_flush(batch_t *b, const ctx_t *ctx)
+{
+    if (b->n)
+    {
+        if (b->entries)
+            ctx->vis->on_entry(b->entries, b->n, ctx->vis->user);
+        else
+            ctx->vis->on_dir(b->dirs, b->n, ctx->vis->user);
+    }
+    b->n = 0;
+    b->used = 0;
+}
+
+static void batch_free(batch_t *b)
+{
+    free(b->entries);
+    free(b->dirs);
+    free(b->text);
+}
+
+// reserve a slot and copy `path` into the batch, flushing it first when
+// it is full; returns the stable copy or NULL on allocation failure
+static char *batch_add(batch_t *b, const char *path, const ctx_t *ctx)
+{
+    size_t len = strlen(path) + 1;
+
+    if (b->n == ctx->batch || b->used + len > b->cap) batch_flush(b, ctx);
+
+    if (len > b->cap)
+    {
+        size_t cap = len > ctx->batch * 64 ? len : ctx->batch * 64;
+        char *text = realloc(b->text, cap);
+        if (!text) return NULL;
+        b->text = text;
+        b->cap = cap;
+    }
+
+    char *copy = b->text + b->used;
+    memcpy(copy, path, len);
+    b->used += len;
+    return copy;
+}
+
+static void visit_entry(tstate_t *ts,
+                        const char *path,
+                        const platform_stat_t *st,
+                        uint64_t size,
+                        const ctx_t *ctx)
+{
+    batch_t *b = &ts->ebatch;
+    if (!b->entries) b->entries = malloc(ctx->batch * sizeof(udu_entry_t));
+    if (!b->entries) return;
+
+    char *copy = batch_add(b, path, ctx);
+    if (!copy) return;
+    b->entries[b->n++] = (udu_entry_t){ .path = copy,
+                                         .size = size,
+                                         .apparent = st->size_apparent,
+                                         .allocated = st->size_allocated,
+                                         .mtime = st->mtime,
+                                         .uid = st->uid,
+                                         .gid = st->gid };
+}
+
+static void visit_dir(tstate_t *ts,
+                      const char *path,
+                      const udu_agg_t *agg,
+                      int depth,
+                      const ctx_t *ctx)
+{
+    batch_t *b = &ts->dbatch;
+    if (!b->dirs) b->dirs = malloc(ctx->batch * sizeof(udu_dir_t));
+    if (!b->dirs) return;
+
+    char *copy = batch_add(b, path, ctx);
+    if (!copy) return;
+    b->dirs[b->n++] = (udu_dir_t){ .path = copy, .agg = *agg, .depth = depth };
+}
+
+UDU_SI tstate_t *thread_state(const ctx_t *ctx)
+{
+    return ctx->ts ? &ctx->ts[thread_id()] : NULL;
+}
+
+// per-thread accounting for one file: top-K candidates and owner totals
+UDU_SI void record_thread(tstate_t *ts,
+                          const char *path,
+                          const platform_stat_t *st,
+                          uint64_t size,
+                          const ctx_t *ctx)
+{
+    heap_offer(&ts->files, path, size);
+    if (ctx->vis && ctx->vis->on_entry) visit_entry(ts, path, st, size, ctx);
+    if (ctx->by_user) otab_add(&ts->users, st->uid, size, 1);
+    if (ctx->by_group) otab_add(&ts->groups, st->gid, size, 1);
+}
+
+static void errlog_push(errlog_t *e, const char *path, int code)
+{
+    int i = 0;
+    while (i < e->n && e->v[i].code != code) i++;
+    if (i == e->n)
+    {
+        if (e->n >= e->cap)
+        {
+            int cap = e->cap ? e->cap * 2 : 8;
+            udu_error_t *v = realloc(e->v, cap * sizeof(udu_error_t));
+            if (!v) return;
+            e->v = v;
+            e->cap = cap;
+        }
+        e->v[e->n++] = (udu_error_t){ .code = code };
+    }
+    e->v[i].count++;
+
+    if (e->nsample < ERR_SAMPLES)
+    {
+        char *copy = strdup(path);
+        if (copy)
+            e->sample[e->nsample++] =
+              (udu_failure_t){ .path = copy, .code = code };
+    }
+}
+
+// `code` is the errno of the failed call; pass it in before anything
+// else can overwrite errno
+UDU_SI void record_error(const ctx_t *ctx, const char *path, int code)
+{
+    tstate_t *ts = thread_state(ctx);
+    if (ts) errlog_push(&ts->errs, path, code);
 }
 
 UDU_SI bool is_excluded(const char *name, const char *path, const ctx_t *ctx)
@@ -63,11 +662,16 @@ UDU_SI bool is_excluded(const char *name, const char *path, const ctx_t *ctx)
     return false;
 }
 
-UDU_SI node_t *mk_node(const char *name, uint64_t size, bool dir)
+UDU_SI node_t *mk_node(const char *name,
+                       const platform_stat_t *st,
+                       const ctx_t *ctx)
 {
+    bool dir = st->is_directory;
     node_t *node = malloc(sizeof(node_t));
     node->name = strdup(name);
-    node->size = size;
+    node->apparent = st->size_apparent;
+    node->alloc = st->size_allocated;
+    node->time = stat_time(st, ctx);
     node->dir = dir;
     node->nkids = 0;
     node->cap = dir ? INIT_CAP : 0;
@@ -85,10 +689,10 @@ UDU_SI void node_add(node_t *parent, node_t *child)
     parent->kids[parent->nkids++] = child;
 }
 
-void node_free(node_t *node)
+static void node_free(node_t *node)
 {
     if (!node) return;
-    for (int i = 0; i < node->nkids; i++) node_free(node->kids[i]);
+    for (uint32_t i = 0; i < node->nkids; i++) node_free(node->kids[i]);
     free(node->name);
     free(node->kids);
     free(node);
@@ -102,19 +706,65 @@ UDU_SI int node_cmp(const void *a, const void *b)
     return strcmp(node_a->name, node_b->name);
 }
 
-uint64_t calc_total_size(node_t *node)
+UDU_SI uint64_t node_size(const node_t *node, bool apparent)
+{
+    return apparent ? node->apparent : node->alloc;
+}
+
+static uint64_t calc_total_size(node_t *node, bool apparent)
 {
-    if (!node->dir) return node->size;
+    if (!node->dir) return node_size(node, apparent);
 
-    uint64_t total = node->size;
-    for (int i = 0; i < node->nkids; i++)
-        total += calc_total_size(node->kids[i]);
+    uint64_t total = node_size(node, apparent);
+    for (uint32_t i = 0; i < node->nkids; i++)
+        total += calc_total_size(node->kids[i], apparent);
 
     return total;
 }
 
+static void tree_tally(const node_t *node, const ctx_t *ctx, udu_agg_t *agg)
+{
+    if (!node->dir)
+    {
+        uint64_t size = node_size(node, ctx->apparent);
+        agg_file(agg, size, node->apparent, node->alloc);
+        if (ctx->nages) agg_age(agg, node->time, size, ctx);
+        return;
+    }
+
+    agg->ndirs++;
+    for (uint32_t i = 0; i < node->nkids; i++)
+        tree_tally(node->kids[i], ctx, agg);
+}
+
+// "<size>" or, with --sparse, "<apparent> <allocated> <saved>" for a
+// tree line; saved counts the holes of the files below only
+static char *node_label(node_t *node, const ctx_t *ctx, char *buf, size_t len)
+{
+    char a[32], b[32], c[32];
+    if (!ctx->sparse)
+    {
+        uint64_t size = calc_total_size(node, ctx->apparent);
+        snprintf(buf, len, "%-8s", human_size(size, a, sizeof(a)));
+        return buf;
+    }
+
+    udu_agg_t files = { 0 };
+    tree_tally(node, ctx, &files);
+    snprintf(buf,
+             len,
+             "%-8s %-8s %-8s",
+             human_size(calc_total_size(node, true), a, sizeof(a)),
+             human_size(calc_total_size(node, false), b, sizeof(b)),
+             human_size(files.sparse, c, sizeof(c)));
+    return buf;
+}
+
+// `prefix` is a PREFIX_MAX buffer owned by the caller; each level appends
+// its extension at `plen` and truncates it again on the way back up
 static void print(node_t *node,
-                  const char *prefix,
+                  char *prefix,
+                  size_t plen,
                   bool is_last,
                   const ctx_t *ctx)
 {
@@ -122,12 +772,11 @@ static void print(node_t *node,
 
     if (ctx->verbose)
     {
-        char sizebuf[32];
-        uint64_t display_size = node->dir ? calc_total_size(node) : node->size;
-        printf("%s%s%-8s %s%s\n",
+        char label[128];
+        printf("%s%s%s %s%s\n",
                prefix,
                branch,
-               human_size(display_size, sizebuf, sizeof(sizebuf)),
+               node_label(node, ctx, label, sizeof(label)),
                node->name,
                node->dir ? "/" : "");
     }
@@ -139,98 +788,129 @@ static void print(node_t *node,
     if (node->dir && node->nkids > 0)
     {
         const char *extension = is_last ? SPACE : VERT;
-        size_t prefix_len = strlen(prefix) + 4;
-        char *new_prefix = getbuf(prefix_len + 1);
-        snprintf(new_prefix, prefix_len + 1, "%s%s", prefix, extension);
+        size_t ext_len = strlen(extension);
+        if (plen + ext_len >= PREFIX_MAX) return;
 
-        for (int i = 0; i < node->nkids; i++)
-            print(node->kids[i], new_prefix, i == node->nkids - 1, ctx);
+        memcpy(prefix + plen, extension, ext_len + 1);
+        for (uint32_t i = 0; i < node->nkids; i++)
+            print(node->kids[i],
+                  prefix,
+                  plen + ext_len,
+                  i == node->nkids - 1,
+                  ctx);
+        prefix[plen] = '\0';
     }
 }
 
-UDU_SI void record_file(uint64_t size, ctx_t *ctx)
+static void print_tree(const char *path, node_t *root, const ctx_t *ctx)
 {
-#ifdef _OPENMP
-    #pragma omp atomic
-#endif
-    ctx->size += size;
-#ifdef _OPENMP
-    #pragma omp atomic
-#endif
-    ctx->nfiles++;
+    if (ctx->verbose)
+    {
+        char label[128];
+        printf("%s %s\n", path, node_label(root, ctx, label, sizeof(label)));
+    }
+    else
+    {
+        printf("%s\n", path);
+    }
+
+    char prefix[PREFIX_MAX] = "";
+    for (uint32_t i = 0; i < root->nkids; i++)
+        print(root->kids[i], prefix, 0, i == root->nkids - 1, ctx);
 }
 
-UDU_SI void record_verbose(const char *path, uint64_t size, ctx_t *ctx)
+// --min-sparse-ratio: list files whose length is at least `ratio` times
+// their allocation; a fully unallocated file has an infinite ratio
+static void record_sparse(const char *path,
+                          const platform_stat_t *st,
+                          const ctx_t *ctx)
 {
-    record_file(size, ctx);
+    uint64_t apparent = st->size_apparent;
+    uint64_t allocated = st->size_allocated;
+
+    if (apparent <= allocated ||
+        (double)apparent < ctx->min_sparse_ratio * (double)allocated)
+        return;
+
 #ifdef _OPENMP
     #pragma omp critical(print)
 #endif
     {
-        char sizebuf[32];
-        printf("%-8s %s\n", human_size(size, sizebuf, sizeof(sizebuf)), path);
+        char a[32], b[32], ratio[16];
+        if (allocated)
+            snprintf(
+              ratio, sizeof(ratio), "%.1fx", (double)apparent / allocated);
+        else
+            snprintf(ratio, sizeof(ratio), "inf");
+        printf("%-8s %-8s %7s %s\n",
+               human_size(apparent, a, sizeof(a)),
+               human_size(allocated, b, sizeof(b)),
+               ratio,
+               path);
     }
 }
 
 static node_t *mk_tree(const char *path,
                        const char *name,
-                       ctx_t *ctx,
+                       const ctx_t *ctx,
                        int depth)
 {
-    if (depth > MAX_DEPTH) return NULL;
-
     platform_stat_t st;
-    if (!platform_stat(path, &st)) return NULL;
-
-    uint64_t size = ctx->apparent ? st.size_apparent : st.size_allocated;
+    if (!platform_stat(path, &st))
+    {
+        record_error(ctx, path, errno);
+        return NULL;
+    }
 
     if (!st.is_directory)
     {
-        record_file(size, ctx);
-        return mk_node(name, size, false);
+        if (ctx->filter.on &&
+            !filter_match(&ctx->filter,
+                          &st,
+                          ctx->apparent ? st.size_apparent : st.size_allocated,
+                          ctx))
+            return NULL;
+        if (ctx->min_sparse_ratio > 0) record_sparse(path, &st, ctx);
+        node_t *leaf = mk_node(name, &st, ctx);
+        tstate_t *ts = thread_state(ctx);
+        if (ts)
+            record_thread(ts, path, &st, node_size(leaf, ctx->apparent), ctx);
+        return leaf;
     }
 
-#ifdef _OPENMP
-    #pragma omp atomic
-#endif
-    ctx->ndirs++;
+    // as in walk(): too deep is a failure and not part of the tree
+    if (depth > MAX_DEPTH)
+    {
+        record_error(ctx, path, UDU_ERR_DEPTH);
+        return NULL;
+    }
 
-    node_t *node = mk_node(name, size, true);
+    node_t *node = mk_node(name, &st, ctx);
     platform_dir_t *dir = platform_opendir(path);
-    if (!dir) return node;
-
-    size_t path_len = strlen(path);
-    char *pathbuf = getbuf(path_len + 512);
-
-    if (path_len > 0 && path[path_len - 1] == '/')
+    if (!dir)
     {
-        memcpy(pathbuf, path, path_len);
-        pathbuf[path_len] = '\0';
+        record_error(ctx, path, errno);
+        return node;
     }
-    else
+
+    pathbuf_t pb;
+    if (!pathbuf_init(&pb, path))
     {
-        memcpy(pathbuf, path, path_len);
-        pathbuf[path_len] = '/';
-        pathbuf[path_len + 1] = '\0';
-        path_len++;
+        platform_closedir(dir);
+        return node;
     }
 
     const char *entry;
     while ((entry = platform_readdir(dir)))
     {
-        size_t entry_len = strlen(entry);
-        size_t full_len = path_len + entry_len;
-        if (full_len + 1 > bufsz) pathbuf = getbuf(full_len + 1);
-
-        memcpy(pathbuf + path_len, entry, entry_len + 1);
-
-        if (is_excluded(entry, pathbuf, ctx) || is_symlink(pathbuf)) continue;
+        if (!pathbuf_set(&pb, entry)) continue;
+        if (is_excluded(entry, pb.p, ctx) || is_symlink(pb.p)) continue;
 
-        char *fullpath = strdup(pathbuf);
+        char *fullpath = strdup(pb.p);
         char *entry_copy = strdup(entry);
 
 #ifdef _OPENMP
-    #pragma omp task firstprivate(fullpath, entry_copy, depth) shared(ctx, node)
+    #pragma omp task firstprivate(fullpath, entry_copy, depth) shared(node)
 #endif
         {
             node_t *child = mk_tree(fullpath, entry_copy, ctx, depth + 1);
@@ -249,199 +929,683 @@ static node_t *mk_tree(const char *path,
 #ifdef _OPENMP
     #pragma omp taskwait
 #endif
+    free(pb.p);
     platform_closedir(dir);
+
+    if (node->nkids > 1)
+        qsort(node->kids, node->nkids, sizeof(node_t *), node_cmp);
+    // files only, as walk() ranks them; calc_total_size() would add the
+    // directories' own st_size
+    tstate_t *ts = thread_state(ctx);
+    if (ts && depth > 0 && ts->dirs.k)
+    {
+        udu_agg_t files = { 0 };
+        tree_tally(node, ctx, &files);
+        heap_offer(&ts->dirs, path, files.size);
+    }
     return node;
 }
 
-static void walk(const char *path, ctx_t *ctx, int depth)
+UDU_SI void jobs_collect(job_t *jobs, udu_agg_t *agg)
 {
-    if (depth > MAX_DEPTH) return;
+    while (jobs)
+    {
+        job_t *next = jobs->next;
+        agg_add(agg, &jobs->agg);
+        free(jobs);
+        jobs = next;
+    }
+}
 
-    platform_dir_t *dir = platform_opendir(path);
-    if (!dir) return;
+// the walker proper, once per variant; see walk_tpl.h
+#define WALK_APPARENT 0
+#define WALK_EXCL 0
+#define WALK_FULL 0
+#include "walk_tpl.h"
+#define WALK_APPARENT 0
+#define WALK_EXCL 0
+#define WALK_FULL 1
+#include "walk_tpl.h"
+#define WALK_APPARENT 0
+#define WALK_EXCL 1
+#define WALK_FULL 0
+#include "walk_tpl.h"
+#define WALK_APPARENT 0
+#define WALK_EXCL 1
+#define WALK_FULL 1
+#include "walk_tpl.h"
+#define WALK_APPARENT 1
+#define WALK_EXCL 0
+#define WALK_FULL 0
+#include "walk_tpl.h"
+#define WALK_APPARENT 1
+#define WALK_EXCL 0
+#define WALK_FULL 1
+#include "walk_tpl.h"
+#define WALK_APPARENT 1
+#define WALK_EXCL 1
+#define WALK_FULL 0
+#include "walk_tpl.h"
+#define WALK_APPARENT 1
+#define WALK_EXCL 1
+#define WALK_FULL 1
+#include "walk_tpl.h"
+
+typedef void walker_fn(const char *, const ctx_t *, int, udu_agg_t *);
+
+// indexed by ctx_t.variant
+static walker_fn *const walkers[] = {
+    walk_000, walk_001, walk_010, walk_011,
+    walk_100, walk_101, walk_110, walk_111,
+};
+
+static int hint_cmp(const void *a, const void *b)
+{
+    return strcmp(((const hint_t *)a)->path, ((const hint_t *)b)->path);
+}
+
+static hint_t *hints_find(const hints_t *h, const char *path)
+{
+    hint_t key = { .path = (char *)path };
+    return h->n ? bsearch(&key, h->v, h->n, sizeof(hint_t), hint_cmp) : NULL;
+}
+
+static bool hints_push(hints_t *h, const char *path, uint64_t weight)
+{
+    if (h->n >= h->cap)
+    {
+        size_t cap = h->cap ? h->cap * 2 : INIT_CAP;
+        hint_t *v = realloc(h->v, cap * sizeof(hint_t));
+        if (!v) return false;
+        h->v = v;
+        h->cap = cap;
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return false;
+    h->v[h->n++] = (hint_t){ .path = copy, .weight = weight };
+    return true;
+}
+
+// file format: one "<entries>\t<path>" line per root
+static void hints_load(hints_t *h, const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) return;
+
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &linecap, fp)) > 0)
+    {
+        if (line[len - 1] == '\n') line[len - 1] = '\0';
+
+        char *tab;
+        uint64_t weight = strtoull(line, &tab, 10);
+        if (*tab != '\t' || !tab[1]) continue;
+        if (!hints_push(h, tab + 1, weight)) break;
+    }
+
+    free(line);
+    fclose(fp);
+    if (h->n > 1) qsort(h->v, h->n, sizeof(hint_t), hint_cmp);
+}
+
+static void hints_save(hints_t *h, const char *file, const udu_result_t *res)
+{
+    for (int i = 0; i < res->nroots; i++)
+    {
+        const udu_root_t *root = &res->roots[i];
+        if (!root->ok) continue;
+
+        uint64_t weight = root->agg.nfiles + root->agg.ndirs;
+        hint_t *hint = hints_find(h, root->path);
+        if (hint)
+            hint->weight = weight;
+        else if (hints_push(h, root->path, weight) && h->n > 1)
+            qsort(h->v, h->n, sizeof(hint_t), hint_cmp);
+    }
+
+    size_t len = strlen(file);
+    char *tmp = malloc(len + 5);
+    if (!tmp) return;
+    memcpy(tmp, file, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE *fp = fopen(tmp, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "Error: cannot write '%s'\n", tmp);
+        free(tmp);
+        return;
+    }
+
+    for (size_t i = 0; i < h->n; i++)
+        fprintf(fp, "%llu\t%s\n", (unsigned long long)h->v[i].weight,
+                h->v[i].path);
+
+    if (fclose(fp) != 0 || rename(tmp, file) != 0)
+    {
+        fprintf(stderr, "Error: cannot write '%s'\n", file);
+        remove(tmp);
+    }
+    free(tmp);
+}
+
+static void hints_free(hints_t *h)
+{
+    for (size_t i = 0; i < h->n; i++) free(h->v[i].path);
+    free(h->v);
+    memset(h, 0, sizeof(*h));
+}
+
+typedef struct
+{
+    uint64_t weight;
+    int idx;
+} rank_t;
+
+static int rank_cmp(const void *a, const void *b)
+{
+    const rank_t *ra = a;
+    const rank_t *rb = b;
+    if (ra->weight != rb->weight) return ra->weight < rb->weight ? 1 : -1;
+    return ra->idx - rb->idx;
+}
+
+// spawn order for the roots: heaviest first by the previous run's entry
+// count so big roots don't start last and leave the pool idle at the end;
+// unknown roots keep argument order
+static int *root_order(const args_t *cfg, const hints_t *hints)
+{
+    int n = cfg->path_count;
+    int *order = malloc(n * sizeof(int));
+    if (!order) return NULL;
+    for (int i = 0; i < n; i++) order[i] = i;
+
+    if (hints->n == 0 || n < 2) return order;
+
+    rank_t *ranks = malloc(n * sizeof(rank_t));
+    if (!ranks) return order;
+
+    for (int i = 0; i < n; i++)
+    {
+        const hint_t *hint = hints_find(hints, cfg->paths[i]);
+        ranks[i] = (rank_t){ .weight = hint ? hint->weight : 0, .idx = i };
+    }
+
+    qsort(ranks, n, sizeof(rank_t), rank_cmp);
+    for (int i = 0; i < n; i++) order[i] = ranks[i].idx;
+    free(ranks);
+    return order;
+}
+
+// trees are printed in argument order as soon as every earlier root is
+// done, so scanning never waits on output; caller holds critical(print)
+static void emit_trees(const args_t *cfg,
+                       node_t **trees,
+                       const bool *done,
+                       int *next,
+                       const ctx_t *ctx)
+{
+    while (*next < cfg->path_count && done[*next])
+    {
+        if (trees[*next])
+        {
+            print_tree(cfg->paths[*next], trees[*next], ctx);
+            node_free(trees[*next]);
+        }
+        (*next)++;
+    }
+}
+
+static void scan_root(udu_root_t *root, const ctx_t *ctx, node_t **tree)
+{
+    const char *path = root->path;
+
+    platform_stat_t st;
+    if (!platform_stat(path, &st))
+    {
+        record_error(ctx, path, errno);
+        return;
+    }
+    root->ok = true;
 
-    size_t path_len = strlen(path);
-    char *pathbuf = getbuf(path_len + 512);
+    // a file operand is subject to the filters like any file found below
+    uint64_t size = ctx->apparent ? st.size_apparent : st.size_allocated;
+    if (!st.is_directory && ctx->filter.on &&
+        !filter_match(&ctx->filter, &st, size, ctx))
+        return;
 
-    if (path_len > 0 && path[path_len - 1] == '/')
+    if (ctx->tree)
     {
-        memcpy(pathbuf, path, path_len);
-        pathbuf[path_len] = '\0';
+        const char *basename = strrchr(path, '/');
+        basename = basename ? basename + 1 : path;
+
+        // a file root takes mk_tree()'s leaf path too, so it reaches the
+        // top-files heap, the owner tables and the sparse listing
+        *tree = mk_tree(path, basename, ctx, 0);
+        if (*tree) tree_tally(*tree, ctx, &root->agg);
+    }
+    else if (st.is_directory)
+    {
+        walkers[ctx->variant](path, ctx, 0, &root->agg);
+        root->agg.ndirs++;
     }
     else
     {
-        memcpy(pathbuf, path, path_len);
-        pathbuf[path_len] = '/';
-        pathbuf[path_len + 1] = '\0';
-        path_len++;
+        agg_file(&root->agg, size, st.size_apparent, st.size_allocated);
+        if (ctx->nages) agg_age(&root->agg, stat_time(&st, ctx), size, ctx);
+        if (ctx->min_sparse_ratio > 0) record_sparse(path, &st, ctx);
+        tstate_t *ts = thread_state(ctx);
+        if (ts) record_thread(ts, path, &st, size, ctx);
     }
+}
 
-    const char *entry;
-    while ((entry = platform_readdir(dir)))
+static int top_cmp(const void *a, const void *b)
+{
+    const udu_top_t *ta = a;
+    const udu_top_t *tb = b;
+    if (ta->size != tb->size) return ta->size < tb->size ? 1 : -1;
+    return strcmp(ta->path, tb->path);
+}
+
+// concatenate the per-thread heaps, keep the k largest, largest first
+static udu_top_t *top_merge(tstate_t *ts,
+                            int nthreads,
+                            bool dirs,
+                            int *count)
+{
+    *count = 0;
+
+    size_t total = 0;
+    for (int t = 0; t < nthreads; t++)
+        total += dirs ? ts[t].dirs.n : ts[t].files.n;
+
+    udu_top_t *all = malloc((total ? total : 1) * sizeof(udu_top_t));
+    size_t n = 0;
+    int k = dirs ? ts->dirs.k : ts->files.k;
+    for (int t = 0; t < nthreads; t++)
     {
-        size_t entry_len = strlen(entry);
-        size_t full_len = path_len + entry_len;
-        if (full_len + 1 > bufsz) pathbuf = getbuf(full_len + 1);
+        heap_t *h = dirs ? &ts[t].dirs : &ts[t].files;
+        for (int i = 0; i < h->n; i++)
+        {
+            if (all)
+                all[n++] = h->v[i];
+            else
+                free(h->v[i].path);
+        }
+        free(h->v);
+    }
+    if (!all) return NULL;
 
-        memcpy(pathbuf + path_len, entry, entry_len + 1);
+    qsort(all, n, sizeof(udu_top_t), top_cmp);
+    while (n > (size_t)k) free(all[--n].path);
 
-        if (is_excluded(entry, pathbuf, ctx) || is_symlink(pathbuf)) continue;
+    *count = (int)n;
+    return all;
+}
 
-        platform_stat_t st;
-        if (!platform_stat(pathbuf, &st)) continue;
+static int dir_cmp(const void *a, const void *b)
+{
+    return strcmp(((const udu_dir_t *)a)->path, ((const udu_dir_t *)b)->path);
+}
 
-        char *fullpath = strdup(pathbuf);
+static udu_dir_t *dir_merge(tstate_t *ts, int nthreads, size_t *count)
+{
+    size_t total = 0;
+    for (int t = 0; t < nthreads; t++) total += ts[t].log.n;
 
-        if (st.is_directory)
+    udu_dir_t *all = malloc((total ? total : 1) * sizeof(udu_dir_t));
+    size_t n = 0;
+    for (int t = 0; t < nthreads; t++)
+    {
+        for (size_t i = 0; i < ts[t].log.n; i++)
         {
-#ifdef _OPENMP
-    #pragma omp task firstprivate(fullpath, depth) shared(ctx)
-#endif
+            if (all)
+                all[n++] = ts[t].log.v[i];
+            else
+                free(ts[t].log.v[i].path);
+        }
+        free(ts[t].log.v);
+    }
+
+    if (all && n > 1) qsort(all, n, sizeof(udu_dir_t), dir_cmp);
+    *count = n;
+    return all;
+}
+
+static int owner_cmp(const void *a, const void *b)
+{
+    const udu_owner_t *oa = a;
+    const udu_owner_t *ob = b;
+    if (oa->size != ob->size) return oa->size < ob->size ? 1 : -1;
+    return oa->id < ob->id ? -1 : oa->id > ob->id;
+}
+
+// fold the per-thread tables into one, largest owner first
+static udu_owner_t *owner_merge(tstate_t *ts,
+                                int nthreads,
+                                bool groups,
+                                int *count)
+{
+    otab_t all = { 0 };
+    for (int t = 0; t < nthreads; t++)
+    {
+        otab_t *tab = groups ? &ts[t].groups : &ts[t].users;
+        for (uint32_t i = 0; i < tab->cap; i++)
+        {
+            const udu_owner_t *o = &tab->v[i];
+            if (o->id != OTAB_EMPTY) otab_add(&all, o->id, o->size, o->nfiles);
+        }
+        free(tab->v);
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < all.cap; i++)
+        if (all.v[i].id != OTAB_EMPTY) all.v[n++] = all.v[i];
+
+    if (n > 1) qsort(all.v, n, sizeof(udu_owner_t), owner_cmp);
+    *count = (int)n;
+    return all.v;
+}
+
+static int error_cmp(const void *a, const void *b)
+{
+    const udu_error_t *ea = a;
+    const udu_error_t *eb = b;
+    if (ea->count != eb->count) return ea->count < eb->count ? 1 : -1;
+    return ea->code - eb->code;
+}
+
+static int failure_cmp(const void *a, const void *b)
+{
+    return strcmp(((const udu_failure_t *)a)->path,
+                  ((const udu_failure_t *)b)->path);
+}
+
+static void error_merge(tstate_t *ts, int nthreads, udu_result_t *res)
+{
+    errlog_t all = { 0 };
+    udu_failure_t sample[ERR_SAMPLES * 2];
+    int nsample = 0;
+
+    for (int t = 0; t < nthreads; t++)
+    {
+        errlog_t *e = &ts[t].errs;
+        for (int i = 0; i < e->n; i++)
+        {
+            res->nfailed += e->v[i].count;
+            int j = 0;
+            while (j < all.n && all.v[j].code != e->v[i].code) j++;
+            if (j == all.n)
             {
-                walk(fullpath, ctx, depth + 1);
-                free(fullpath);
+                if (all.n >= all.cap)
+                {
+                    int cap = all.cap ? all.cap * 2 : 8;
+                    udu_error_t *v = realloc(all.v, cap * sizeof(*v));
+                    if (!v) continue;
+                    all.v = v;
+                    all.cap = cap;
+                }
+                all.v[all.n++] = (udu_error_t){ .code = e->v[i].code };
             }
-#ifdef _OPENMP
-    #pragma omp atomic
-#endif
-            ctx->ndirs++;
+            all.v[j].count += e->v[i].count;
         }
-        else
+        free(e->v);
+
+        // keep the ERR_SAMPLES smallest paths across threads
+        for (int i = 0; i < e->nsample; i++)
         {
-            uint64_t size =
-              ctx->apparent ? st.size_apparent : st.size_allocated;
-            if (ctx->verbose)
-                record_verbose(fullpath, size, ctx);
-            else
-                record_file(size, ctx);
-            free(fullpath);
+            sample[nsample++] = e->sample[i];
+            if (nsample == ERR_SAMPLES * 2)
+            {
+                qsort(sample, nsample, sizeof(*sample), failure_cmp);
+                for (int k = ERR_SAMPLES; k < nsample; k++)
+                    free(sample[k].path);
+                nsample = ERR_SAMPLES;
+            }
         }
     }
 
-#ifdef _OPENMP
-    #pragma omp taskwait
-#endif
-    platform_closedir(dir);
+    if (all.n > 1) qsort(all.v, all.n, sizeof(udu_error_t), error_cmp);
+    res->errors = all.v;
+    res->nerrors = all.n;
+
+    if (nsample > 1) qsort(sample, nsample, sizeof(*sample), failure_cmp);
+    for (int k = ERR_SAMPLES; k < nsample; k++) free(sample[k].path);
+    if (nsample > ERR_SAMPLES) nsample = ERR_SAMPLES;
+
+    res->failures = nsample ? malloc(nsample * sizeof(udu_failure_t)) : NULL;
+    if (res->failures)
+    {
+        memcpy(res->failures, sample, nsample * sizeof(udu_failure_t));
+        res->nfailures = nsample;
+    }
+    else
+    {
+        for (int k = 0; k < nsample; k++) free(sample[k].path);
+    }
+}
+
+void walk_record_error(udu_result_t *res, const char *path, int code)
+{
+    int i = 0;
+    while (i < res->nerrors && res->errors[i].code != code) i++;
+    if (i == res->nerrors)
+    {
+        udu_error_t *v = realloc(res->errors, (i + 1) * sizeof(*v));
+        if (!v) return;
+        res->errors = v;
+        res->errors[res->nerrors++] = (udu_error_t){ .code = code };
+    }
+    res->nfailed++;
+    res->errors[i].count++;
+
+    // most frequent first, as error_merge() leaves them
+    for (; i > 0 && res->errors[i].count > res->errors[i - 1].count; i--)
+    {
+        udu_error_t e = res->errors[i];
+        res->errors[i] = res->errors[i - 1];
+        res->errors[i - 1] = e;
+    }
+
+    if (res->nfailures >= ERR_SAMPLES) return;
+    if (!res->failures)
+        res->failures = malloc(ERR_SAMPLES * sizeof(udu_failure_t));
+    char *copy = res->failures ? strdup(path) : NULL;
+    if (copy)
+        res->failures[res->nfailures++] =
+          (udu_failure_t){ .path = copy, .code = code };
+}
+
+static const char *error_text(int code)
+{
+    return code == UDU_ERR_DEPTH ? "nested too deeply" : strerror(code);
 }
 
-walk_result_t walk_paths(const args_t *cfg)
+// to stderr, after the results: how much of the tree was skipped, why,
+// and a few of the paths
+void walk_print_errors(const udu_result_t *res)
+{
+    fflush(stdout);
+    fprintf(stderr,
+            "\nudu: %lu %s could not be read (",
+            res->nfailed,
+            res->nfailed == 1 ? "entry" : "entries");
+    for (int i = 0; i < res->nerrors; i++)
+        fprintf(stderr,
+                "%s%s: %lu",
+                i ? ", " : "",
+                error_text(res->errors[i].code),
+                res->errors[i].count);
+    fprintf(stderr, ")\n");
+
+    for (int i = 0; i < res->nfailures; i++)
+        fprintf(stderr,
+                "  '%s': %s\n",
+                res->failures[i].path,
+                error_text(res->failures[i].code));
+    if (res->nfailed > (uint64_t)res->nfailures) fprintf(stderr, "  ...\n");
+}
+
+udu_result_t walk_paths(const args_t *cfg, const udu_visitor_t *vis)
 {
     ctx_t ctx = { .excl = cfg->excludes,
                   .nexcl = cfg->exclude_count,
                   .apparent = cfg->apparent_size,
                   .verbose = cfg->verbose,
                   .tree = cfg->tree,
-                  .size = 0,
-                  .nfiles = 0,
-                  .ndirs = 0 };
+                  .sparse = cfg->sparse,
+                  .min_sparse_ratio = cfg->min_sparse_ratio,
+                  .by_user = cfg->by_user,
+                  .by_group = cfg->by_group,
+                  .collect_dirs = cfg->dir_list || cfg->max_depth >= 0,
+                  .dir_depth = cfg->dir_list ? INT_MAX : cfg->max_depth,
+                  .inode_order = cfg->inode_order,
+                  .vis = vis,
+                  .batch = vis && vis->batch ? vis->batch : 256,
+                  .ts = NULL,
+                  .nages = cfg->age_count,
+                  .age_time = cfg->age_time,
+                  .now = (int64_t)time(NULL) };
+    for (int i = 0; i < cfg->age_count; i++)
+        ctx.age_limit[i] = (int64_t)cfg->age_days[i] * 86400;
+
+    filter_t *f = &ctx.filter;
+    f->min_size = cfg->min_size;
+    f->max_size = cfg->max_size;
+    for (const char *t = cfg->types; t && *t; t++) f->types |= type_bit(*t);
+    f->newer = cfg->newer;
+    f->newer_than = cfg->newer_than;
+    f->on = f->min_size > 0 || f->max_size < UINT64_MAX || f->types || f->newer;
 
+    // the plain variant skips all per-file work below the counters
+    bool full = ctx.nages || ctx.min_sparse_ratio > 0 || f->on ||
+                cfg->top_files > 0 || (vis && vis->on_entry) || ctx.by_user ||
+                ctx.by_group;
+    ctx.variant = ctx.apparent * 4 + (ctx.nexcl > 0) * 2 + full;
+
+    int n = cfg->path_count;
+    udu_result_t res = { .roots = calloc(n, sizeof(udu_root_t)),
+                          .nroots = n };
+
+    hints_t hints = { 0 };
+    if (cfg->root_cache) hints_load(&hints, cfg->root_cache);
+
+    int nthreads = 1;
 #ifdef _OPENMP
-    #pragma omp parallel
-    #pragma omp single
+    nthreads = omp_get_max_threads();
 #endif
+    // always there: read errors are counted in it
+    // calloc() only promises max_align_t; tstate_t wants its own lines
+    ctx.ts = platform_aligned_calloc(_Alignof(tstate_t),
+                                     nthreads * sizeof(tstate_t));
+    for (int t = 0; ctx.ts && t < nthreads; t++)
     {
-        for (int i = 0; i < cfg->path_count; i++)
-        {
-            const char *path = cfg->paths[i];
+        ctx.ts[t].files.k = cfg->top_files;
+        ctx.ts[t].dirs.k = cfg->top_dirs;
+    }
 
+    int *order = root_order(cfg, &hints);
+    node_t **trees = ctx.tree ? calloc(n, sizeof(node_t *)) : NULL;
+    bool *done = ctx.tree ? calloc(n, sizeof(bool)) : NULL;
+    int next = 0;
+
+    if (!res.roots || !order || (ctx.tree && (!trees || !done)) || !ctx.ts)
+    {
+        fprintf(stderr, "Error: out of memory\n");
+        free(res.roots);
+        res.roots = NULL;
+        res.nroots = 0;
+        goto out;
+    }
+
+    for (int i = 0; i < n; i++) res.roots[i].path = cfg->paths[i];
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
 #ifdef _OPENMP
-    #pragma omp task firstprivate(path, i) shared(ctx)
+    #pragma omp single
 #endif
+        {
+            for (int k = 0; k < n; k++)
             {
-                platform_stat_t st;
-                if (!platform_stat(path, &st))
-                {
+                int i = order[k];
+
 #ifdef _OPENMP
-    #pragma omp critical(print)
+    #pragma omp task firstprivate(i) shared(res, trees, done, next)
 #endif
-                    {
-                        fprintf(stderr, "Error: cannot stat '%s'\n", path);
-                    }
-                }
-                else if (ctx.tree)
                 {
-                    const char *basename = strrchr(path, '/');
-                    basename = basename ? basename + 1 : path;
-
-                    node_t *root = NULL;
+                    scan_root(&res.roots[i], &ctx, trees ? &trees[i] : NULL);
 
-                    if (st.is_directory)
+                    if (ctx.tree)
                     {
-                        root = mk_tree(path, basename, &ctx, 0);
-                    }
-                    else
-                    {
-                        uint64_t size =
-                          ctx.apparent ? st.size_apparent : st.size_allocated;
-                        root = mk_node(basename, size, false);
-                        record_file(size, &ctx);
-                    }
-
 #ifdef _OPENMP
     #pragma omp critical(print)
 #endif
-                    {
-                        if (root)
                         {
-                            if (root->nkids > 0)
-                            {
-                                qsort(root->kids,
-                                      root->nkids,
-                                      sizeof(node_t *),
-                                      node_cmp);
-                            }
-
-                            if (ctx.verbose)
-                            {
-                                char sizebuf[32];
-                                uint64_t display_size =
-                                  root->dir ? calc_total_size(root)
-                                            : root->size;
-                                printf("%s %-8s\n",
-                                       path,
-                                       human_size(display_size,
-                                                  sizebuf,
-                                                  sizeof(sizebuf)));
-                            }
-                            else
-                            {
-                                printf("%s\n", path);
-                            }
-
-                            if (root->nkids > 0)
-                            {
-                                for (int j = 0; j < root->nkids; j++)
-                                    print(root->kids[j],
-                                          "",
-                                          j == root->nkids - 1,
-                                          &ctx);
-                            }
-                            node_free(root);
+                            done[i] = true;
+                            emit_trees(cfg, trees, done, &next, &ctx);
                         }
                     }
                 }
-                else if (st.is_directory)
-                {
-                    walk(path, &ctx, 0);
-#ifdef _OPENMP
-    #pragma omp atomic
-#endif
-                    ctx.ndirs++;
-                }
-                else
-                {
-                    uint64_t size =
-                      ctx.apparent ? st.size_apparent : st.size_allocated;
-                    if (ctx.verbose)
-                        record_verbose(path, size, &ctx);
-                    else
-                        record_file(size, &ctx);
-                }
             }
         }
+
+        // every task has finished at the barrier closing the single;
+        // each thread hands over its own leftover visitor batches
+        tstate_t *ts = thread_state(&ctx);
+        if (ts && vis)
+        {
+            batch_flush(&ts->ebatch, &ctx);
+            batch_flush(&ts->dbatch, &ctx);
+        }
+    }
+
+    for (int i = 0; i < n; i++) agg_add(&res.total, &res.roots[i].agg);
+
+    if (ctx.ts)
+    {
+        res.top_files = top_merge(ctx.ts, nthreads, false, &res.ntop_files);
+        res.top_dirs = top_merge(ctx.ts, nthreads, true, &res.ntop_dirs);
+        res.users = owner_merge(ctx.ts, nthreads, false, &res.nusers);
+        res.groups = owner_merge(ctx.ts, nthreads, true, &res.ngroups);
+        res.dir_list = dir_merge(ctx.ts, nthreads, &res.ndir_list);
+        error_merge(ctx.ts, nthreads, &res);
+        for (int t = 0; t < nthreads; t++)
+        {
+            batch_free(&ctx.ts[t].ebatch);
+            batch_free(&ctx.ts[t].dbatch);
+        }
     }
 
-    return (walk_result_t){ .total_size = ctx.size,
-                            .nfiles = ctx.nfiles,
-                            .ndirs = ctx.ndirs };
+    if (cfg->root_cache) hints_save(&hints, cfg->root_cache, &res);
+
+out:
+    hints_free(&hints);
+    free(order);
+    free(trees);
+    free(done);
+    platform_aligned_free(ctx.ts);
+    return res;
+}
+
+void walk_result_free(udu_result_t *res)
+{
+    for (int i = 0; i < res->ntop_files; i++) free(res->top_files[i].path);
+    for (int i = 0; i < res->ntop_dirs; i++) free(res->top_dirs[i].path);
+    free(res->top_files);
+    free(res->top_dirs);
+    for (size_t i = 0; i < res->ndir_list; i++) free(res->dir_list[i].path);
+    free(res->dir_list);
+    free(res->users);
+    free(res->groups);
+    free(res->errors);
+    for (int i = 0; i < res->nfailures; i++) free(res->failures[i].path);
+    free(res->failures);
+    free(res->roots);
+    memset(res, 0, sizeof(*res));
 }
@@ -2,16 +2,20 @@
 #define UDU_WALK_H
 
 #include "args.h"
+#include "udu.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-typedef struct
-{
-    uint64_t total_size;
-    uint64_t nfiles;
-    uint64_t ndirs;
-} walk_result_t;
+// `vis` may be NULL
+udu_result_t walk_paths(const args_t *cfg, const udu_visitor_t *vis);
+void walk_result_free(udu_result_t *res);
 
-walk_result_t walk_paths(const args_t *cfg);
+// the error accounting of walk_paths() for code that reads the tree
+// itself (the daemon): count a failure in `res` and keep a sample of
+// paths. Not thread-safe
+void walk_record_error(udu_result_t *res, const char *path, int code);
+
+// the failure summary udu prints after its results, to stderr
+void walk_print_errors(const udu_result_t *res);
 
 #endif
@@ -0,0 +1,251 @@
+/*
+ * One variant of the directory walker. walk.c includes this file once
+ * per combination of
+ *
+ *   WALK_APPARENT  1: count apparent sizes, 0: allocated sizes
+ *   WALK_EXCL      1: there are -X patterns to test
+ *   WALK_FULL      1: some per-file feature is on (filters, ages, sparse
+ *                  listing, top files, owners, the entry visitor)
+ *
+ * and picks one in walk_paths(), so each variant is compiled with these
+ * as constants. With all three at 0 a file costs a readdir(), an
+ * fstatat() on the open directory and a few additions: no path is built
+ * and nothing is allocated.
+ *
+ * No include guard: it is meant to be included repeatedly.
+ */
+
+#define WALK_CAT_(base, a, x, f) base##_##a##x##f
+#define WALK_CAT(base, a, x, f) WALK_CAT_(base, a, x, f)
+#define WALK WALK_CAT(walk, WALK_APPARENT, WALK_EXCL, WALK_FULL)
+#define WALK_ENTRY WALK_CAT(walk_entry, WALK_APPARENT, WALK_EXCL, WALK_FULL)
+#define WALK_CHUNK WALK_CAT(walk_chunk, WALK_APPARENT, WALK_EXCL, WALK_FULL)
+
+// the full path is needed up front to match patterns, to report files
+// and where the platform can only stat by path
+#define WALK_PATH_FIRST (WALK_EXCL || WALK_FULL || !PLATFORM_STAT_AT)
+
+UDU_HOT static void WALK(const char *path,
+                        const ctx_t *ctx,
+                        int depth,
+                        udu_agg_t *out);
+
+// stat one entry of `dir` (whose path with a trailing '/' is in `pb`);
+// files are added to `agg`, subdirectories are queued on `jobs` and
+// walked as tasks
+static void WALK_ENTRY(pathbuf_t *pb,
+                       platform_dir_t *dir,
+                       const char *entry,
+                       char type,
+                       const ctx_t *ctx,
+                       int depth,
+                       tstate_t *ts,
+                       udu_agg_t *agg,
+                       job_t **jobs)
+{
+    (void)type;
+    (void)ts;
+#if WALK_FULL
+    // d_type settles --type without a stat for most entries
+    const filter_t *f = &ctx->filter;
+    if (f->types && type && type != 'd' && !(f->types & type_bit(type)))
+        return;
+#endif
+
+    size_t full_len = 0;
+#if WALK_PATH_FIRST
+    full_len = pathbuf_set(pb, entry);
+    if (!full_len) return;
+#endif
+#if WALK_EXCL
+    if (is_excluded(entry, pb->p, ctx)) return;
+#endif
+
+    platform_stat_t st;
+    if (!platform_stat_at(dir, entry, pb->p, &st))
+    {
+        int err = errno;
+        if (WALK_PATH_FIRST || pathbuf_set(pb, entry))
+            record_error(ctx, pb->p, err);
+        return;
+    }
+    if (st.type == 'l') return;
+
+    if (st.is_directory)
+    {
+        if (!WALK_PATH_FIRST) full_len = pathbuf_set(pb, entry);
+        if (!full_len) return;
+
+        // too deep to descend: a failure, not a directory in the totals
+        if (depth + 1 > MAX_DEPTH)
+        {
+            record_error(ctx, pb->p, UDU_ERR_DEPTH);
+            return;
+        }
+
+        job_t *job = malloc(sizeof(job_t) + full_len + 1);
+        if (!job) return;
+        memcpy(job->path, pb->p, full_len + 1);
+        job->next = *jobs;
+        *jobs = job;
+        agg->ndirs++;
+
+#ifdef _OPENMP
+    #pragma omp task firstprivate(job, depth)
+#endif
+        WALK(job->path, ctx, depth + 1, &job->agg);
+        return;
+    }
+
+    uint64_t size = WALK_APPARENT ? st.size_apparent : st.size_allocated;
+#if WALK_FULL
+    if (f->on && !filter_match(f, &st, size, ctx)) return;
+#endif
+    agg_file(agg, size, st.size_apparent, st.size_allocated);
+#if WALK_FULL
+    if (ctx->nages) agg_age(agg, stat_time(&st, ctx), size, ctx);
+    if (ctx->min_sparse_ratio > 0) record_sparse(pb->p, &st, ctx);
+    if (ts) record_thread(ts, pb->p, &st, size, ctx);
+#endif
+}
+
+// stat a slice of a dense directory on whichever thread picks it up
+UDU_HOT static void WALK_CHUNK(chunk_t *c,
+                               platform_dir_t *dir,
+                               const char *path,
+                               const ctx_t *ctx,
+                               int depth)
+{
+    pathbuf_t pb;
+    if (!pathbuf_init(&pb, path)) return;
+
+    tstate_t *ts = thread_state(ctx);
+    job_t *jobs = NULL;
+    for (size_t i = 0, off = 0; i < c->n; i++)
+    {
+        char type = c->text[off];
+        const char *entry = c->text + off + 1;
+        off += strlen(entry) + 2;
+        WALK_ENTRY(&pb, dir, entry, type, ctx, depth, ts, &c->agg, &jobs);
+    }
+
+#ifdef _OPENMP
+    #pragma omp taskwait
+#endif
+    free(pb.p);
+    jobs_collect(jobs, &c->agg);
+}
+
+UDU_HOT static void WALK(const char *path,
+                        const ctx_t *ctx,
+                        int depth,
+                        udu_agg_t *out)
+{
+    udu_agg_t agg = { 0 };
+    *out = agg;
+
+    platform_dir_t *dir = platform_opendir(path);
+    if (!dir)
+    {
+        record_error(ctx, path, errno);
+        return;
+    }
+
+    pathbuf_t pb;
+    if (!pathbuf_init(&pb, path))
+    {
+        platform_closedir(dir);
+        return;
+    }
+
+    // a failed load may have consumed part of the stream: start over
+    dents_t dents = { 0 };
+    bool sorted = ctx->inode_order && dents_load(&dents, dir);
+    if (ctx->inode_order && !sorted)
+    {
+        platform_closedir(dir);
+        dir = platform_opendir(path);
+        if (!dir)
+        {
+            record_error(ctx, path, errno);
+            free(dents.v);
+            free(dents.text);
+            free(pb.p);
+            return;
+        }
+    }
+
+    // tied tasks never migrate, so the thread slot is fixed for this call
+    tstate_t *ts = thread_state(ctx);
+    job_t *jobs = NULL;
+    chunk_t *chunks = NULL;
+    chunk_t *cur = NULL;
+    size_t count = 0;
+    const char *entry;
+    char type = 0;
+    while ((entry = sorted ? dents_next(&dents, &type) : platform_readdir(dir)))
+    {
+        if (!sorted) type = platform_dir_type(dir);
+
+        // past DENSE_MIN entries the rest of the listing is handed out in
+        // chunks, so one huge flat directory keeps the whole pool busy
+        if (++count <= DENSE_MIN || (!cur && !(cur = chunk_new())) ||
+            !chunk_add(cur, entry, type))
+        {
+            WALK_ENTRY(&pb, dir, entry, type, ctx, depth, ts, &agg, &jobs);
+            continue;
+        }
+        if (cur->n < DENSE_CHUNK) continue;
+
+        cur->next = chunks;
+        chunks = cur;
+#ifdef _OPENMP
+    #pragma omp task firstprivate(cur, depth)
+#endif
+        WALK_CHUNK(cur, dir, path, ctx, depth);
+        cur = NULL;
+    }
+    if (cur)
+    {
+        cur->next = chunks;
+        chunks = cur;
+        WALK_CHUNK(cur, dir, path, ctx, depth);
+    }
+
+    // chunk tasks stat through `dir`; it stays open until they are done
+#ifdef _OPENMP
+    #pragma omp taskwait
+#endif
+    free(dents.v);
+    free(dents.text);
+    free(pb.p);
+    platform_closedir(dir);
+
+    jobs_collect(jobs, &agg);
+    while (chunks)
+    {
+        chunk_t *next = chunks->next;
+        agg_add(&agg, &chunks->agg);
+        free(chunks->text);
+        free(chunks);
+        chunks = next;
+    }
+
+    // subtree totals are final here, so --top-dirs needs no second pass
+    if (ts && depth > 0) heap_offer(&ts->dirs, path, agg.size);
+    if (ts && ctx->collect_dirs && depth <= ctx->dir_depth)
+        dirlog_push(&ts->log, path, &agg, depth);
+    if (ts && ctx->vis && ctx->vis->on_dir)
+        visit_dir(ts, path, &agg, depth, ctx);
+    *out = agg;
+}
+
+#undef WALK_PATH_FIRST
+#undef WALK_CHUNK
+#undef WALK_ENTRY
+#undef WALK
+#undef WALK_CAT
+#undef WALK_CAT_
+#undef WALK_FULL
+#undef WALK_EXCL
+#undef WALK_APPARENT